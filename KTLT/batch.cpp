@@ -0,0 +1,112 @@
+// Runs many campaigns and prints one "label<TAB>printResult()" line per
+// scenario, in input order. Build and run with batch.sh.
+// With --theaters every scenario is treated as one theater of a single
+// campaign: each line also gets the theater's LF/EXP and unit-count deltas
+// and the units the Liberation Army confiscated, and a final TOTAL line sums
+// them over the theaters that did not fail.
+// Configuration problems go to stderr; the exit status is 1 if any scenario
+// failed to load or had one.
+// Built with -DHCM_INSTRUMENT, the default mode also writes the CampaignStats
+// report summed over every scenario to stderr.
+//   batch [-j N] [--theaters] --dir DIR
+//   batch [-j N] --list FILE
+//   batch [-j N] --base CONFIG [--sweep KEY=from:to[:step]]...
+//   batch [-j N] CONFIG...
+
+#include "theater_engine.h"
+
+using namespace std;
+
+// "N", or "N[TYPE:count;...]" listing every confiscated type.
+static string confiscationSummary(const ConfiscationTally &tally) {
+    string out = to_string(tally.total());
+    string types;
+    for (int t = 0; t <= TANK; ++t)
+        if (tally.vehicles[t]) types += string(types.empty() ? "" : ";") + UnitNameTable::name(VEHICLE_UNIT, t) + ":" + to_string(tally.vehicles[t]);
+    for (int t = 0; t <= REGULARINFANTRY; ++t)
+        if (tally.infantry[t]) types += string(types.empty() ? "" : ";") + UnitNameTable::name(INFANTRY_UNIT, t) + ":" + to_string(tally.infantry[t]);
+    return types.empty() ? out : out + "[" + types + "]";
+}
+
+static int usage() {
+    cerr << "usage: batch [-j N] [--theaters] (--dir DIR | --list FILE | --base CONFIG [--sweep KEY=from:to[:step]]... | CONFIG...)" << endl;
+    return 2;
+}
+
+int main(int argc, const char * argv[]) {
+    unsigned workers = 0;
+    bool theaters = false;
+    string dir, list, base;
+    vector<ParameterSweep> sweeps;
+    vector<Scenario> scenarios;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-j" && hasValue) workers = atoi(argv[++i]);
+        else if (arg == "--theaters") theaters = true;
+        else if (arg == "--dir" && hasValue) dir = argv[++i];
+        else if (arg == "--list" && hasValue) list = argv[++i];
+        else if (arg == "--base" && hasValue) base = argv[++i];
+        else if (arg == "--sweep" && hasValue) {
+            ParameterSweep sweep;
+            if (!BatchRunner::parseSweep(argv[++i], sweep)) {
+                cerr << "bad sweep: " << argv[i] << endl;
+                return usage();
+            }
+            sweeps.push_back(sweep);
+        } else if (arg[0] == '-') return usage();
+        else {
+            Scenario s;
+            s.label = s.path = arg;
+            scenarios.push_back(s);
+        }
+    }
+    if (!sweeps.empty() && base.empty()) return usage();
+
+    bool ok = true;
+    if (!dir.empty()) ok = ok && BatchRunner::scenariosFromDirectory(dir, scenarios);
+    if (!list.empty()) ok = ok && BatchRunner::scenariosFromList(list, scenarios);
+    if (!base.empty()) ok = ok && BatchRunner::scenariosFromSweeps(base, sweeps, scenarios);
+    if (!ok) {
+        cerr << "cannot read scenario source" << endl;
+        return 1;
+    }
+    if (scenarios.empty()) return usage();
+
+    WorkStealingPool pool(workers);
+    if (theaters) {
+        TheaterReport report;
+        bool clean = TheaterEngine::run(scenarios, pool, report);
+        for (size_t i = 0; i < scenarios.size(); ++i) {
+            const TheaterOutcome &o = report.outcomes[i];
+            cout << scenarios[i].label << "\t" << o.result;
+            if (!o.failed) {
+                cout << "\tliberation_lf=" << o.liberationLF[1] - o.liberationLF[0]
+                     << ",liberation_exp=" << o.liberationEXP[1] - o.liberationEXP[0]
+                     << ",arvn_lf=" << o.arvnLF[1] - o.arvnLF[0]
+                     << ",arvn_exp=" << o.arvnEXP[1] - o.arvnEXP[0]
+                     << ",liberation_unit_delta=" << o.liberationUnitCount[1] - o.liberationUnitCount[0]
+                     << ",arvn_unit_delta=" << o.arvnUnitCount[1] - o.arvnUnitCount[0]
+                     << ",confiscated=" << confiscationSummary(o.confiscated);
+            }
+            cout << "\n";
+        }
+        cout << "TOTAL\tliberation_lf=" << report.liberationLFDelta << ",liberation_exp=" << report.liberationEXPDelta
+             << ",arvn_lf=" << report.arvnLFDelta << ",arvn_exp=" << report.arvnEXPDelta
+             << ",liberation_unit_delta=" << report.liberationUnitCountDelta
+             << ",arvn_unit_delta=" << report.arvnUnitCountDelta
+             << ",confiscated=" << confiscationSummary(report.confiscated)
+             << ",failed=" << report.failed << "\n";
+        return clean ? 0 : 1;
+    }
+    vector<string> results;
+#ifdef HCM_INSTRUMENT
+    CampaignStats totals;
+    bool clean = BatchRunner::run(scenarios, pool, results, totals);
+    cerr << totals.report();
+#else
+    bool clean = BatchRunner::run(scenarios, pool, results);
+#endif
+    for (size_t i = 0; i < scenarios.size(); ++i) cout << scenarios[i].label << "\t" << results[i] << "\n";
+    return clean ? 0 : 1;
+}
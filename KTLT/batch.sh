@@ -0,0 +1,2 @@
+g++ -O2 -o batch batch.cpp batch_runner.cpp theater_engine.cpp scenario_binary.cpp hcmcampaign.cpp -I . -std=c++11 -pthread
+./batch "$@"
@@ -0,0 +1,238 @@
+#include "batch_runner.h"
+#include "scenario_binary.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// ====================== WorkStealingPool ==========================
+WorkStealingPool::WorkStealingPool(unsigned workers) : workers(workers) {
+    if (this->workers == 0) this->workers = thread::hardware_concurrency();
+    if (this->workers == 0) this->workers = 1;
+}
+unsigned WorkStealingPool::getWorkerCount() const { return workers; }
+bool WorkStealingPool::popOwn(WorkQueue &queue, size_t &job) {
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.jobs.empty()) return false;
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+bool WorkStealingPool::steal(vector<WorkQueue> &queues, unsigned thief, size_t &job) {
+    for (unsigned k = 1; k < queues.size(); ++k) {
+        WorkQueue &victim = queues[(thief + k) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (victim.jobs.empty()) continue;
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+void WorkStealingPool::run(size_t jobCount, const function<void(size_t)> &job) {
+    unsigned n = (unsigned)min<size_t>(workers, jobCount);
+    if (n <= 1) {
+        for (size_t i = 0; i < jobCount; ++i) job(i);
+        return;
+    }
+    // Jobs are only ever removed once filled, so an empty sweep of every
+    // queue means the worker is done.
+    vector<WorkQueue> queues(n);
+    for (unsigned w = 0; w < n; ++w)
+        for (size_t i = jobCount * w / n; i < jobCount * (w + 1) / n; ++i) queues[w].jobs.push_back(i);
+
+    vector<thread> threads;
+    for (unsigned w = 0; w < n; ++w)
+        threads.push_back(thread([this, &queues, &job, w]() {
+            size_t i;
+            while (popOwn(queues[w], i) || steal(queues, w, i)) job(i);
+        }));
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+}
+
+// ====================== BatchRunner ==========================
+static bool readFile(const string &path, string &out) {
+    ifstream fin(path.c_str(), ios::binary);
+    if (!fin) return false;
+    ostringstream oss;
+    oss << fin.rdbuf();
+    out = oss.str();
+    return true;
+}
+
+static bool parseIntField(const string &s, int &out) {
+    if (s.empty()) return false;
+    char *end;
+    long v = strtol(s.c_str(), &end, 10);
+    if (*end != '\0') return false;
+    out = (int)v;
+    return true;
+}
+
+// KEY=from:to[:step]
+bool BatchRunner::parseSweep(const string &spec, ParameterSweep &sweep) {
+    size_t eq = spec.find('=');
+    if (eq == string::npos || eq == 0) return false;
+    sweep.key = spec.substr(0, eq);
+    string range = spec.substr(eq + 1);
+    size_t c1 = range.find(':');
+    if (c1 == string::npos) return false;
+    size_t c2 = range.find(':', c1 + 1);
+    sweep.step = 1;
+    if (!parseIntField(range.substr(0, c1), sweep.from)) return false;
+    if (!parseIntField(range.substr(c1 + 1, c2 == string::npos ? string::npos : c2 - c1 - 1), sweep.to)) return false;
+    if (c2 != string::npos && !parseIntField(range.substr(c2 + 1), sweep.step)) return false;
+    return sweep.step > 0 && sweep.from <= sweep.to;
+}
+
+bool BatchRunner::scenariosFromDirectory(const string &dir, vector<Scenario> &out) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) return false;
+    vector<string> names;
+    while (dirent *entry = readdir(d)) {
+        string path = dir + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) names.push_back(entry->d_name);
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); ++i) {
+        Scenario s;
+        s.label = names[i];
+        s.path = dir + "/" + names[i];
+        out.push_back(s);
+    }
+    return true;
+}
+
+bool BatchRunner::scenariosFromList(const string &listFile, vector<Scenario> &out) {
+    ifstream fin(listFile.c_str());
+    if (!fin) return false;
+    string line;
+    while (getline(fin, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+        Scenario s;
+        s.label = s.path = line;
+        out.push_back(s);
+    }
+    return true;
+}
+
+static string withKey(const string &text, const string &key, int value) {
+    string replacement = key + "=" + to_string(value);
+    string result;
+    bool replaced = false;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t nl = text.find('\n', start);
+        size_t end = nl == string::npos ? text.size() : nl;
+        string line = text.substr(start, end - start);
+        if (line.compare(0, key.size() + 1, key + "=") == 0) {
+            line = replacement;
+            replaced = true;
+        }
+        result += line;
+        result += '\n';
+        start = end + 1;
+    }
+    if (!replaced) result += replacement + "\n";
+    return result;
+}
+
+bool BatchRunner::scenariosFromSweeps(const string &baseConfig, const vector<ParameterSweep> &sweeps, vector<Scenario> &out) {
+    string base;
+    if (!readFile(baseConfig, base)) return false;
+    // Odometer over the sweeps; the last one varies fastest.
+    vector<int> value(sweeps.size());
+    for (size_t k = 0; k < sweeps.size(); ++k) value[k] = sweeps[k].from;
+    while (true) {
+        Scenario s;
+        s.label = baseConfig;
+        s.text = base;
+        for (size_t k = 0; k < sweeps.size(); ++k) {
+            s.label += " " + sweeps[k].key + "=" + to_string(value[k]);
+            s.text = withKey(s.text, sweeps[k].key, value[k]);
+        }
+        out.push_back(s);
+
+        size_t k = sweeps.size();
+        while (k > 0) {
+            --k;
+            value[k] += sweeps[k].step;
+            if (value[k] <= sweeps[k].to) break;
+            value[k] = sweeps[k].from;
+            if (k == 0) return true;
+        }
+        if (sweeps.empty()) return true;
+    }
+}
+
+HCMCampaign *BatchRunner::open(const Scenario &scenario) {
+    if (!scenario.text.empty()) {
+        istringstream in(scenario.text);
+        return new HCMCampaign(in, scenario.label);
+    }
+    if (!ScenarioBinary::isBinaryPath(scenario.path)) {
+        // Configuration reads a missing file as an empty one.
+        ifstream probe(scenario.path.c_str());
+        return probe ? new HCMCampaign(scenario.path) : nullptr;
+    }
+    Configuration *config = ScenarioBinary::load(scenario.path);
+    return config ? new HCMCampaign(config) : nullptr;
+}
+
+typedef function<void(size_t, const HCMCampaign &)> CampaignInspector;
+
+static void resolveScenario(const Scenario &scenario, size_t index, const CampaignInspector &inspect,
+                            string &result, char &clean) {
+    unique_ptr<HCMCampaign> campaign(BatchRunner::open(scenario));
+    if (!campaign) {
+        result = "error: cannot load " + scenario.path;
+        return;
+    }
+    clean = campaign->getDiagnostics().empty();
+    campaign->run();
+    result = campaign->printResult();
+    if (inspect) inspect(index, *campaign);
+}
+
+// Runs every scenario and hands each campaign to inspect (when set) before
+// it is freed, on the worker that ran it. An exception escaping a worker
+// would terminate the process, so a scenario that throws gets an error row
+// and counts as not clean; the others carry on.
+static bool runAll(const vector<Scenario> &scenarios, WorkStealingPool &pool, vector<string> &results,
+                   const CampaignInspector &inspect) {
+    results.assign(scenarios.size(), string());
+    vector<char> clean(scenarios.size(), 0);
+    pool.run(scenarios.size(), [&scenarios, &results, &clean, &inspect](size_t i) {
+        try {
+            resolveScenario(scenarios[i], i, inspect, results[i], clean[i]);
+        } catch (const exception &e) {
+            clean[i] = 0;
+            results[i] = string("error: ") + e.what();
+        } catch (...) {
+            clean[i] = 0;
+            results[i] = "error: unknown exception";
+        }
+    });
+    for (size_t i = 0; i < clean.size(); ++i)
+        if (!clean[i]) return false;
+    return true;
+}
+
+bool BatchRunner::run(const vector<Scenario> &scenarios, WorkStealingPool &pool, vector<string> &results) {
+    return runAll(scenarios, pool, results, nullptr);
+}
+
+#ifdef HCM_INSTRUMENT
+// Each campaign's counters are copied into its own slot and summed
+// afterwards, so workers never share a CampaignStats.
+bool BatchRunner::run(const vector<Scenario> &scenarios, WorkStealingPool &pool, vector<string> &results, CampaignStats &totals) {
+    vector<CampaignStats> stats(scenarios.size());
+    bool clean = runAll(scenarios, pool, results, [&stats](size_t i, const HCMCampaign &campaign) { stats[i] = campaign.getStats(); });
+    for (size_t i = 0; i < stats.size(); ++i) totals.add(stats[i]);
+    return clean;
+}
+#endif
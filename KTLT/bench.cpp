@@ -0,0 +1,462 @@
+// Micro-benchmarks for the campaign engine.
+// Build and run with bench.sh. Every result is printed as one CSV row:
+//   bench,variant,n,ms,mb_per_s
+// mb_per_s is only filled in by throughput benchmarks, where n is in bytes.
+//
+//   bench                                         every benchmark below
+//   bench phases ROWS COLS DENSITY UNITS VEH% ROUNDS  per-phase timings of one scenario
+//   bench gen ROWS COLS DENSITY UNITS VEH%        print the generated config
+//
+// Built with -DHCM_INSTRUMENT (bench_stats.sh), phases also writes the
+// CampaignStats report summed over its rounds to stderr.
+
+#include "scenario_binary.h"
+#include "scenario_generator.h"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const string &bench, const string &variant, long long n, double ms) {
+    cout << bench << "," << variant << "," << n << "," << fixed << setprecision(3) << ms << "," << endl;
+}
+static void reportThroughput(const string &bench, const string &variant, long long bytes, double ms) {
+    cout << bench << "," << variant << "," << bytes << "," << fixed << setprecision(3) << ms << ","
+         << (ms > 0 ? bytes / 1e6 / (ms / 1e3) : 0.0) << endl;
+}
+
+static ScenarioRandom benchRandom(12345);
+static int nextRandom(int lo, int hi) {
+    return benchRandom.next(lo, hi);
+}
+
+static Unit** makeUnits(int n) {
+    Unit **units = new Unit*[n];
+    for (int i = 0; i < n; ++i) {
+        Position pos(i % 100, i / 100);
+        if (i % 2 == 0) units[i] = new Vehicle(1 + i % 7, 1 + i % 5, pos, (VehicleType)(i % 7));
+        else units[i] = new Infantry(1 + i % 6, 1 + i % 5, pos, (InfantryType)(i % 6));
+    }
+    return units;
+}
+
+// ---------------------- RTTI vs kind tag ----------------------
+// Slot lookup as UnitList::insert did it before units carried a kind tag.
+static int slotByDynamicCast(Unit *unit) {
+    Vehicle *v = dynamic_cast<Vehicle*>(unit);
+    if (v) return v->getVehicleType();
+    Infantry *i = dynamic_cast<Infantry*>(unit);
+    if (i) return 7 + i->getInfantryType();
+    return -1;
+}
+static int slotByKind(Unit *unit) {
+    if (unit->getKind() == VEHICLE_UNIT) return static_cast<Vehicle*>(unit)->getVehicleType();
+    if (unit->getKind() == INFANTRY_UNIT) return 7 + static_cast<Infantry*>(unit)->getInfantryType();
+    return -1;
+}
+
+void b_unit_dispatch(int n, int rounds) {
+    Unit **units = makeUnits(n);
+    long long sink = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < n; ++i) sink += slotByDynamicCast(units[i]);
+    report("unit_dispatch", "dynamic_cast", (long long)n * rounds, elapsedMs(start));
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < n; ++i) sink -= slotByKind(units[i]);
+    report("unit_dispatch", "kind_tag", (long long)n * rounds, elapsedMs(start));
+
+    if (sink != 0) cerr << "unit_dispatch: variants disagree" << endl;
+    for (int i = 0; i < n; ++i) delete units[i];
+    delete[] units;
+}
+
+void b_army_construction(int n) {
+    Unit **units = makeUnits(n);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    LiberationArmy *army = new LiberationArmy(units, n, "LiberationArmy", nullptr);
+    report("army_construction", "heap", n, elapsedMs(start));
+    start = chrono::steady_clock::now();
+    delete army;
+    report("army_teardown", "heap", n, elapsedMs(start));
+
+    UnitPool *pool = new UnitPool();
+    start = chrono::steady_clock::now();
+    army = new LiberationArmy(units, n, "LiberationArmy", nullptr, pool);
+    report("army_construction", "pool", n, elapsedMs(start));
+    start = chrono::steady_clock::now();
+    delete army;
+    delete pool;
+    report("army_teardown", "pool", n, elapsedMs(start));
+
+    for (int i = 0; i < n; ++i) delete units[i];
+    delete[] units;
+}
+
+// ---------------------- SoA scoring ----------------------
+void b_score_view(int n, int rounds) {
+    Unit **units = makeUnits(n);
+    ArmyScoreView view;
+    for (int i = 0; i < n; ++i) view.add(units[i]);
+    int lf, exp, lfScalar = 0, expScalar = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) view.computeScoresScalar(lfScalar, expScalar);
+    report("score_view", "scalar", (long long)n * rounds, elapsedMs(start));
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) view.computeScores(lf, exp);
+    report("score_view", "lanes", (long long)n * rounds, elapsedMs(start));
+
+    if (lf != lfScalar || exp != expScalar) cerr << "score_view: variants disagree" << endl;
+    for (int i = 0; i < n; ++i) delete units[i];
+    delete[] units;
+}
+
+// ---------------------- combination search ----------------------
+static long long bruteForceMinAbove(const vector<int> &scores, int threshold) {
+    long long best = -1;
+    int n = scores.size();
+    for (long long mask = 1; mask < (1LL << n); ++mask) {
+        long long sum = 0;
+        for (int b = 0; b < n; ++b)
+            if (mask >> b & 1) sum += scores[b];
+        if (sum > threshold && (best < 0 || sum < best)) best = sum;
+    }
+    return best;
+}
+
+void b_combination(int n, int threshold, int trials) {
+    vector<vector<int> > cases(trials);
+    for (int t = 0; t < trials; ++t)
+        for (int i = 0; i < n; ++i) cases[t].push_back(nextRandom(1, 2 * threshold / n + 1));
+
+    vector<long long> expected(trials);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int t = 0; t < trials; ++t) expected[t] = bruteForceMinAbove(cases[t], threshold);
+    report("combination_n" + to_string(n), "brute_force", trials, elapsedMs(start));
+
+    vector<int> chosen;
+    int mismatches = 0;
+    start = chrono::steady_clock::now();
+    for (int t = 0; t < trials; ++t) {
+        long long sum = -1;
+        if (CombinationSelector::selectMinAbove(cases[t], threshold, chosen)) {
+            sum = 0;
+            for (size_t i = 0; i < chosen.size(); ++i) sum += cases[t][chosen[i]];
+        }
+        if (sum != expected[t]) mismatches++;
+    }
+    report("combination_n" + to_string(n), "selector", trials, elapsedMs(start));
+    if (mismatches) cerr << "combination: " << mismatches << " mismatches" << endl;
+}
+
+// ---------------------- unit name dispatch ----------------------
+// The if/else string-compare chain the loader used, extended to every name.
+static bool lookupByChain(const string &name, UnitKind &kind, int &type) {
+    kind = VEHICLE_UNIT;
+    if (name == "TRUCK") type = TRUCK;
+    else if (name == "MORTAR") type = MORTAR;
+    else if (name == "ANTIAIRCRAFT") type = ANTIAIRCRAFT;
+    else if (name == "ARMOREDCAR") type = ARMOREDCAR;
+    else if (name == "APC") type = APC;
+    else if (name == "ARTILLERY") type = ARTILLERY;
+    else if (name == "TANK") type = TANK;
+    else {
+        kind = INFANTRY_UNIT;
+        if (name == "SNIPER") type = SNIPER;
+        else if (name == "ANTIAIRCRAFTSQUAD") type = ANTIAIRCRAFTSQUAD;
+        else if (name == "MORTARSQUAD") type = MORTARSQUAD;
+        else if (name == "ENGINEER") type = ENGINEER;
+        else if (name == "SPECIALFORCES") type = SPECIALFORCES;
+        else if (name == "REGULARINFANTRY") type = REGULARINFANTRY;
+        else return false;
+    }
+    return true;
+}
+
+void b_unit_name_lookup(int n) {
+    vector<string> names(n);
+    for (int i = 0; i < n; ++i) names[i] = benchRandom.unitName();
+    UnitKind kind;
+    int type;
+    long long sink = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        if (lookupByChain(names[i], kind, type)) sink += kind * 16 + type;
+    report("unit_name_lookup", "if_else_chain", n, elapsedMs(start));
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        if (UnitNameTable::lookup(names[i].data(), names[i].size(), kind, type)) sink -= kind * 16 + type;
+    report("unit_name_lookup", "perfect_hash", n, elapsedMs(start));
+
+    if (sink != 0) cerr << "unit_name_lookup: variants disagree" << endl;
+}
+
+// ---------------------- personal number ----------------------
+// The iterated digit sum ScoreEngine::personalNumber replaced with a closed form.
+static int personalNumberByLoop(int score) {
+    int n = score + 1975;
+    while (n >= 10) {
+        int s = 0, t = n;
+        while (t) { s += t % 10; t /= 10; }
+        n = s;
+    }
+    return n;
+}
+static int adjustedQuantityByLoop(int infantryType, int quantity, int weight) {
+    int n = personalNumberByLoop(ScoreEngine::infantryScore(infantryType, quantity, weight));
+    if (n > 7) return (int)ceil(quantity * 1.2);
+    if (n < 3) return (int)floor(quantity * 0.9);
+    return quantity;
+}
+
+void b_personal_number(int n) {
+    vector<int> type(n), quantity(n), weight(n);
+    for (int i = 0; i < n; ++i) {
+        type[i] = nextRandom(0, 5);
+        quantity[i] = nextRandom(1, 50);
+        weight[i] = nextRandom(1, 50);
+    }
+    long long sink = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) sink += adjustedQuantityByLoop(type[i], quantity[i], weight[i]);
+    report("personal_number", "digit_sum_loop", n, elapsedMs(start));
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) sink -= ScoreEngine::adjustedQuantity(type[i], quantity[i], weight[i]);
+    report("personal_number", "digital_root_table", n, elapsedMs(start));
+
+    if (sink != 0) cerr << "personal_number: variants disagree" << endl;
+}
+
+// ---------------------- terrain lookup ----------------------
+static int terrainByScan(const BattleField &field, int r, int c) {
+    int type = ROAD;
+    for (int t = FOREST; t <= SPECIAL_ZONE; ++t) {
+        const vector<Position> &cells = field.getTerrainPositions((TerrainType)t);
+        for (size_t i = 0; i < cells.size(); ++i)
+            if (cells[i].getRow() == r && cells[i].getCol() == c) type = t;
+    }
+    return type;
+}
+
+// terrainCells on a rows x rows map: few cells give the sparse table, many the bit-planes.
+void b_terrain_lookup(int rows, int terrainCells, int queries, bool withScan) {
+    vector<Position*> typed[SPECIAL_ZONE];
+    for (int i = 0; i < terrainCells; ++i)
+        typed[nextRandom(0, SPECIAL_ZONE - 1)].push_back(new Position(nextRandom(0, rows - 1), nextRandom(0, rows - 1)));
+    BattleField field(rows, rows, typed[0], typed[1], typed[2], typed[3], typed[4]);
+    vector<Position> probes(queries);
+    for (int i = 0; i < queries; ++i) probes[i] = Position(nextRandom(0, rows - 1), nextRandom(0, rows - 1));
+    string variant = field.getTerrainGrid().isSparse() ? "grid_sparse" : "grid_dense";
+    long long sink = 0;
+
+    if (withScan) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < queries; ++i) sink += terrainByScan(field, probes[i].getRow(), probes[i].getCol());
+        report("terrain_lookup_" + to_string(terrainCells), "linear_scan", queries, elapsedMs(start));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) sink -= field.terrainAt(probes[i]);
+    report("terrain_lookup_" + to_string(terrainCells), variant, queries, elapsedMs(start));
+
+    if (withScan && sink != 0) cerr << "terrain_lookup: variants disagree" << endl;
+    for (int t = 0; t < SPECIAL_ZONE; ++t)
+        for (size_t i = 0; i < typed[t].size(); ++i) delete typed[t][i];
+}
+
+// ---------------------- config parsing ----------------------
+static long long writeConfig(const string &path, int units) {
+    ofstream out(path.c_str());
+    out << "NUM_ROWS=1000\nNUM_COLS=1000\n";
+    out << "ARRAY_FOREST=[(1,2),(3,5),(10,10)]\nARRAY_RIVER=[(0,0),(0,4)]\n";
+    out << "ARRAY_FORTIFICATION=[(6,6)]\nARRAY_URBAN=[(2,0)]\nARRAY_SPECIAL_ZONE=[(9,7)]\n";
+    out << "UNIT_LIST=[";
+    for (int i = 0; i < units; ++i) {
+        if (i > 0) out << ",";
+        out << benchRandom.unitName() << "(" << nextRandom(1, 20) << "," << nextRandom(1, 20)
+            << ",(" << nextRandom(0, 999) << "," << nextRandom(0, 999) << ")," << (i % 3 == 0) << ")";
+    }
+    out << "]\nEVENT_CODE=23\n";
+    return (long long)out.tellp();
+}
+
+void b_config_parse(int units, int rounds) {
+    string path = "bench_config.txt";
+    long long bytes = writeConfig(path, units);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        Configuration config(path);
+        if (config.getLiberationUnitsCount() + config.getARVNUnitsCount() != units)
+            cerr << "config_parse: lost units" << endl;
+    }
+    reportThroughput("config_parse", "streaming", bytes * rounds, elapsedMs(start));
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        UnitPool pool;
+        Configuration config(path, &pool);
+        if (config.getLiberationUnitsCount() + config.getARVNUnitsCount() != units)
+            cerr << "config_parse: lost units" << endl;
+    }
+    reportThroughput("config_parse", "streaming_pool", bytes * rounds, elapsedMs(start));
+
+    // Same scenario compiled to .hcmb; n stays the text size so the rows compare.
+    string binaryPath = "bench_config.hcmb";
+    ScenarioBinary::convert(path, binaryPath);
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        Configuration *config = ScenarioBinary::load(binaryPath);
+        if (!config || config->getLiberationUnitsCount() + config->getARVNUnitsCount() != units)
+            cerr << "config_parse: lost units" << endl;
+        delete config;
+    }
+    reportThroughput("config_parse", "binary_mmap", bytes * rounds, elapsedMs(start));
+    remove(binaryPath.c_str());
+    remove(path.c_str());
+}
+
+// ---------------------- campaign fork ----------------------
+void b_campaign_fork(int units, int rounds) {
+    string path = "bench_config.txt";
+    writeConfig(path, units);
+    long long sink = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        HCMCampaign campaign(path);
+        campaign.applyTerrain();
+        sink += campaign.printResult().size();
+    }
+    report("campaign_fork", "construct", rounds, elapsedMs(start));
+
+    HCMCampaign campaign(path);
+    campaign.applyTerrain();
+    CampaignSnapshot snapshot;
+    campaign.saveTo(snapshot);
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        campaign.restoreFrom(snapshot);
+        sink -= campaign.printResult().size();
+    }
+    report("campaign_fork", "restore", rounds, elapsedMs(start));
+
+    if (sink != 0) cerr << "campaign_fork: variants disagree" << endl;
+    remove(path.c_str());
+}
+
+// ---------------------- synthetic scenarios ----------------------
+static string generateScenario(const ScenarioSpec &spec) {
+    return ScenarioGenerator::generate(spec, benchRandom) + "EVENT_CODE=" + to_string(nextRandom(0, 99)) + "\n";
+}
+
+// Parsing, then every step of the deployment and standard pipelines timed on
+// its own; a step that appears more than once reports its total.
+void b_phases(const ScenarioSpec &spec, int rounds) {
+    string text = generateScenario(spec);
+    string label = ScenarioGenerator::label(spec);
+    CampaignPipeline steps = CampaignPipeline::deployment().add(CampaignPipeline::standard());
+    vector<string> names;
+    vector<int> nameOf(steps.size());
+    for (int i = 0; i < steps.size(); ++i) {
+        size_t k = 0;
+        while (k < names.size() && names[k] != steps[i].name) ++k;
+        if (k == names.size()) names.push_back(steps[i].name);
+        nameOf[i] = k;
+    }
+    vector<double> stepMs(names.size(), 0);
+    double parseMs = 0, strMs = 0;
+    long long sink = 0;
+#ifdef HCM_INSTRUMENT
+    CampaignStats stats;
+    CampaignStats *savedStats = CampaignStats::current;
+    CampaignStats::current = &stats;
+#endif
+    for (int r = 0; r < rounds; ++r) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        istringstream in(text);
+        Configuration *config = new Configuration(in);
+        parseMs += elapsedMs(start);
+
+        CampaignState state(config, nullptr, config->getEventCode());
+        for (int i = 0; i < steps.size(); ++i) {
+            start = chrono::steady_clock::now();
+            steps[i].apply(state);
+            stepMs[nameOf[i]] += elapsedMs(start);
+        }
+
+        start = chrono::steady_clock::now();
+        sink += config->str().size() + state.battleField->str().size() + state.liberationArmy->str().size()
+              + state.arvn->str().size() + state.result.size();
+        strMs += elapsedMs(start);
+
+        delete state.liberationArmy;
+        delete state.arvn;
+        delete state.battleField;
+        delete config;
+    }
+#ifdef HCM_INSTRUMENT
+    CampaignStats::current = savedStats;
+    cerr << stats.report();
+#endif
+    reportThroughput("phase_parse", label, (long long)text.size() * rounds, parseMs);
+    for (size_t k = 0; k < names.size(); ++k) report("phase_" + names[k], label, rounds, stepMs[k]);
+    report("phase_str", label, rounds, strMs);
+    if (sink == 0) cerr << "phases: nothing rendered" << endl;
+}
+
+static bool parseSpec(int argc, const char *argv[], ScenarioSpec &spec) {
+    if (argc < 7) return false;
+    spec.rows = atoi(argv[2]);
+    spec.cols = atoi(argv[3]);
+    spec.terrainDensity = atof(argv[4]);
+    spec.units = atoi(argv[5]);
+    spec.vehiclePercent = atoi(argv[6]);
+    return spec.rows > 0 && spec.cols > 0 && spec.units >= 0;
+}
+
+int main(int argc, const char * argv[]) {
+    ScenarioSpec spec;
+    if (argc > 1 && string(argv[1]) == "gen") {
+        if (!parseSpec(argc, argv, spec)) return 2;
+        cout << generateScenario(spec);
+        return 0;
+    }
+    cout << "bench,variant,n,ms,mb_per_s" << endl;
+    if (argc > 1 && string(argv[1]) == "phases") {
+        if (!parseSpec(argc, argv, spec)) return 2;
+        b_phases(spec, argc > 7 ? atoi(argv[7]) : 10);
+        return 0;
+    }
+    if (argc > 1) {
+        cerr << "usage: bench [phases|gen ROWS COLS DENSITY UNITS VEHICLE_PERCENT [ROUNDS]]" << endl;
+        return 2;
+    }
+    b_unit_dispatch(100000, 20);
+    b_army_construction(100000);
+    b_score_view(100000, 100);
+    b_combination(13, 1000, 1000);
+    b_combination(20, 1000, 20);
+    b_combination(22, 500, 4);
+    b_unit_name_lookup(10000000);
+    b_personal_number(10000000);
+    b_terrain_lookup(10000, 1000, 100000, true);
+    b_terrain_lookup(1000, 500000, 10000000, false);
+    b_config_parse(300000, 5);
+    b_campaign_fork(1000, 1000);
+    ScenarioSpec small = { 10, 8, 0.1, 20, 50 };
+    ScenarioSpec large = { 1000, 1000, 0.01, 100000, 50 };
+    b_phases(small, 1000);
+    b_phases(large, 5);
+    return 0;
+}
@@ -0,0 +1,2 @@
+g++ -O2 -o bench bench.cpp scenario_generator.cpp scenario_binary.cpp hcmcampaign.cpp -I . -std=c++11
+./bench
\ No newline at end of file
@@ -0,0 +1,3 @@
+g++ -O2 -DHCM_INSTRUMENT -o bench_stats bench.cpp scenario_generator.cpp scenario_binary.cpp campaign_stats.cpp hcmcampaign.cpp -I . -std=c++11
+if [ $# -eq 0 ]; then set -- 1000 1000 0.01 100000 50 5; fi
+./bench_stats phases "$@"
\ No newline at end of file
@@ -0,0 +1,13 @@
+// Stage clock for -DHCM_INSTRUMENT builds. Kept out of hcmcampaign.cpp so the
+// graded files stay within main.h's libraries; every instrumented build must
+// link this file (see bench_stats.sh).
+
+#include "hcmcampaign.h"
+#include <chrono>
+
+// ====================== CampaignStats clock ==========================
+#ifdef HCM_INSTRUMENT
+long long CampaignStats::clockNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
@@ -0,0 +1,378 @@
+// Consistency checks for the campaign engine: every fast path against a plain
+// reference on randomly generated input. Build and run with check.sh. Every
+// check prints one CSV row:
+//   check,cases,failures
+// and the exit status is 1 if any check failed.
+//
+//   check          every check below
+//   check NAME...  only the named checks (remove_if, snapshot, confiscation,
+//                  capacity, pipeline, combination, score_lanes)
+
+#include "scenario_generator.h"
+
+using namespace std;
+
+static ScenarioRandom checkRandom(2025);
+static int nextRandom(int lo, int hi) {
+    return checkRandom.next(lo, hi);
+}
+
+static void report(const string &check, long long cases, long long failures) {
+    cout << check << "," << cases << "," << failures << endl;
+}
+
+static Unit *randomUnit(int maxQuantity, int maxWeight, const Position &pos) {
+    if (nextRandom(0, 1)) return new Vehicle(nextRandom(0, maxQuantity), nextRandom(1, maxWeight), pos, (VehicleType)nextRandom(0, 6));
+    return new Infantry(nextRandom(0, maxQuantity), nextRandom(1, maxWeight), pos, (InfantryType)nextRandom(0, 5));
+}
+
+// ---------------------- scenarios ----------------------
+// A small battlefield with a few terrain elements and units of either army
+// scattered over it; the caller appends EVENT_CODE.
+static string randomScenario() {
+    ScenarioSpec spec = { nextRandom(4, 12), nextRandom(4, 12), 0.2, nextRandom(0, 30), 50 };
+    return ScenarioGenerator::generate(spec, checkRandom);
+}
+
+static vector<string> checkScenarios() {
+    vector<string> scenarios;
+    ifstream sample("config.txt");
+    string line, text;
+    while (getline(sample, line))
+        if (line.compare(0, 10, "EVENT_CODE") != 0) text += line + "\n";
+    if (!text.empty()) scenarios.push_back(text);
+    for (int i = 0; i < 40; ++i) scenarios.push_back(randomScenario());
+    return scenarios;
+}
+
+static string withEventCode(const string &scenario, int eventCode) {
+    return scenario + "EVENT_CODE=" + to_string(eventCode) + "\n";
+}
+
+// Everything a campaign's outcome is judged by.
+static string outcome(const Army *liberation, const Army *arvn) {
+    return liberation->str() + arvn->str();
+}
+
+// ---------------------- removeIf vs naive filter ----------------------
+// Lists with random terrain modifiers, culled on effective score; the
+// survivors must keep their order and the running LF/EXP must equal a full
+// recount.
+static long long c_remove_if() {
+    long long failures = 0;
+    const int CASES = 2000;
+    for (int n = 0; n < CASES; ++n) {
+        vector<Unit*> units;
+        for (int i = nextRandom(0, 20); i > 0; --i) units.push_back(randomUnit(9, 5, Position(i, 0)));
+        LiberationArmy army(units.data(), units.size(), "LiberationArmy", nullptr);
+        UnitList *list = army.getUnitList();
+        for (Unit *u : *list)
+            if (nextRandom(0, 2) == 0) u->addTerrainModifier(nextRandom(-30, 30));
+        int threshold = nextRandom(0, 60);
+
+        vector<string> kept;
+        for (int i = 0; i < list->getTotalCount(); ++i)
+            if (list->getUnitAt(i)->getEffectiveScore() > threshold) kept.push_back(list->getUnitAt(i)->str());
+        list->removeIf([threshold](Unit *u) { return u->getEffectiveScore() <= threshold; });
+
+        bool same = (int)kept.size() == list->getTotalCount();
+        for (size_t i = 0; same && i < kept.size(); ++i) same = kept[i] == list->getUnitAt(i)->str();
+        int lf = army.getLF(), exp = army.getEXP();
+        army.updateLF_EXP();
+        if (!same || lf != army.getLF() || exp != army.getEXP()) failures++;
+        for (Unit *u : units) delete u;
+    }
+    report("remove_if", CASES, failures);
+    return failures;
+}
+
+// ---------------------- snapshot/restore vs fresh campaign ----------------------
+// One campaign per scenario, snapshotted after terrain and replayed under
+// every event code, against a campaign built from scratch for that code.
+static long long c_snapshot(const vector<string> &scenarios) {
+    long long cases = 0, failures = 0;
+    for (size_t s = 0; s < scenarios.size(); ++s) {
+        istringstream base(withEventCode(scenarios[s], 0));
+        HCMCampaign forked(base);
+        forked.applyTerrain();
+        CampaignSnapshot snapshot;
+        forked.saveTo(snapshot);
+        for (int eventCode = 0; eventCode < 100; ++eventCode) {
+            forked.restoreFrom(snapshot);
+            forked.resolve(eventCode);
+            istringstream in(withEventCode(scenarios[s], eventCode));
+            HCMCampaign fresh(in);
+            fresh.run();
+            cases++;
+            if (forked.printResult() != fresh.printResult() ||
+                outcome(forked.getLiberationArmy(), forked.getARVN()) != outcome(fresh.getLiberationArmy(), fresh.getARVN()))
+                failures++;
+        }
+    }
+    report("snapshot", cases, failures);
+    return failures;
+}
+
+// ---------------------- confiscation tally vs list growth ----------------------
+// The enemy holds at most one unit per type, so every unit it loses is either
+// merged into a type we already had or appended; anything else was dropped
+// for lack of room and must not be in the tally.
+class ConfiscatingArmy : public LiberationArmy {
+public:
+    ConfiscatingArmy(Unit **unitArray, int size) : LiberationArmy(unitArray, size, "LiberationArmy", nullptr) {}
+    void take(Army *enemy) { confiscate(enemy); }
+};
+
+static int typeOf(const Unit *unit) {
+    if (unit->getKind() == VEHICLE_UNIT) return static_cast<const Vehicle*>(unit)->getVehicleType();
+    return static_cast<const Infantry*>(unit)->getInfantryType();
+}
+
+static bool hasType(const UnitList *list, const Unit *unit) {
+    for (int i = 0; i < list->getTotalCount(); ++i)
+        if (list->getUnitAt(i)->getKind() == unit->getKind() && typeOf(list->getUnitAt(i)) == typeOf(unit)) return true;
+    return false;
+}
+
+static long long c_confiscation() {
+    long long failures = 0;
+    const int CASES = 2000;
+    for (int n = 0; n < CASES; ++n) {
+        vector<Unit*> ours, theirs;
+        for (int i = nextRandom(0, 13); i > 0; --i) ours.push_back(randomUnit(9, 5, Position(i, 0)));
+        for (int i = nextRandom(0, 13); i > 0; --i) theirs.push_back(randomUnit(9, 5, Position(0, i)));
+        ConfiscatingArmy army(ours.data(), ours.size());
+        ARVN enemy(theirs.data(), theirs.size(), "ARVN", nullptr);
+        UnitList *list = army.getUnitList(), *spoils = enemy.getUnitList();
+        int merged = 0, before = list->getTotalCount();
+        for (int i = 0; i < spoils->getTotalCount(); ++i)
+            if (hasType(list, spoils->getUnitAt(i))) merged++;
+        army.take(&enemy);
+        int lf = army.getLF(), exp = army.getEXP();
+        army.updateLF_EXP();
+        if (army.getConfiscated().total() != merged + list->getTotalCount() - before ||
+            spoils->getTotalCount() != 0 || lf != army.getLF() || exp != army.getEXP())
+            failures++;
+        for (Unit *u : ours) delete u;
+        for (Unit *u : theirs) delete u;
+    }
+    report("confiscation", CASES, failures);
+    return failures;
+}
+
+// ---------------------- initial capacity vs starting strength ----------------------
+// Whenever every type the army was given fits its list, the capacity must be
+// the one its starting LF + EXP selects, i.e. after same-type units merged.
+// Some inputs have their score read first, which applies the infantry
+// personal-number adjustment to them before they are copied.
+static long long c_capacity() {
+    long long cases = 0, failures = 0;
+    // Two TRUCK(1,1) merge into one unit of S = 1, which is special.
+    Vehicle truck(1, 1, Position(), TRUCK);
+    Unit *trucks[] = { &truck, &truck };
+    LiberationArmy pair(trucks, 2, "LiberationArmy", nullptr);
+    cases++;
+    if (pair.getUnitList()->getCapacity() != 12) failures++;
+
+    for (int n = 0; n < 2000; ++n) {
+        vector<Unit*> units;
+        vector<bool> types(TANK + 1 + REGULARINFANTRY + 1, false);
+        int distinct = 0;
+        for (int i = nextRandom(0, 16); i > 0; --i) {
+            Unit *u = randomUnit(20, 20, Position(i, 0));
+            if (nextRandom(0, 1)) u->getAttackScore();
+            int slot = (u->getKind() == VEHICLE_UNIT ? 0 : TANK + 1) + typeOf(u);
+            if (!types[slot]) distinct++;
+            types[slot] = true;
+            units.push_back(u);
+        }
+        LiberationArmy army(units.data(), units.size(), "LiberationArmy", nullptr);
+        const UnitList *list = army.getUnitList();
+        if (list->getTotalCount() == distinct) {
+            cases++;
+            if (list->getCapacity() != ScoreEngine::listCapacity(army.getLF() + army.getEXP())) failures++;
+        }
+        for (Unit *u : units) delete u;
+    }
+    report("capacity", cases, failures);
+    return failures;
+}
+
+// ---------------------- pipeline vs reference engage order ----------------------
+// The battle as the spec reads: below 75 the Liberation Army attacks, from 75
+// ARVN attacks and is counterattacked. Each engagement is the attacker's
+// fight, the defender's, then the weak-unit cull on both sides.
+static void engage(Army *attacker, Army *defender) {
+    attacker->fight(defender, false);
+    defender->fight(attacker, true);
+    attacker->getUnitList()->removeIfAttackScoreLE5();
+    defender->getUnitList()->removeIfAttackScoreLE5();
+}
+
+static string referenceOutcome(const string &text, int eventCode) {
+    istringstream in(text);
+    Configuration *config = new Configuration(in);
+    CampaignState state(config, nullptr, eventCode);
+    CampaignSteps::buildBattleField(state);
+    CampaignSteps::buildArmies(state);
+    CampaignSteps::applyTerrain(state);
+    if (eventCode >= 75) engage(state.arvn, state.liberationArmy);
+    engage(state.liberationArmy, state.arvn);
+    string result = outcome(state.liberationArmy, state.arvn);
+    delete state.liberationArmy;
+    delete state.arvn;
+    delete state.battleField;
+    delete config;
+    return result;
+}
+
+// Outcomes known independently of the engine (the assignment's sample run), so
+// a mistake shared by the pipeline and the reference above still shows up.
+struct KnownOutcome {
+    const char *configPath;
+    const char *result;
+};
+
+static long long c_pipeline(const vector<string> &scenarios) {
+    static const KnownOutcome KNOWN[] = {
+        { "config.txt", "LIBERATIONARMY[LF=1000,EXP=406]-ARVN[LF=0,EXP=0]" }
+    };
+    long long cases = 0, failures = 0;
+    for (const KnownOutcome &known : KNOWN) {
+        HCMCampaign campaign(known.configPath);
+        campaign.run();
+        cases++;
+        if (campaign.printResult() != known.result) failures++;
+    }
+    for (size_t s = 0; s < scenarios.size(); ++s) {
+        for (int eventCode = 0; eventCode < 100; ++eventCode) {
+            string text = withEventCode(scenarios[s], eventCode);
+            istringstream in(text);
+            HCMCampaign campaign(in);
+            campaign.run();
+            cases++;
+            if (outcome(campaign.getLiberationArmy(), campaign.getARVN()) != referenceOutcome(text, eventCode)) failures++;
+        }
+    }
+    report("pipeline", cases, failures);
+    return failures;
+}
+
+// ---------------------- combination search vs brute force ----------------------
+// Thresholds in the millions push selectMinAbove past the DP table limit onto
+// meet-in-the-middle; small ones keep it on the DP. Either way the chosen
+// indices must be distinct and add up to the smallest sum above the
+// threshold over every subset of the scores, zeros included.
+static long long bruteForceMinAbove(const vector<int> &scores, int threshold) {
+    long long best = -1;
+    int n = scores.size();
+    for (long long mask = 1; mask < (1LL << n); ++mask) {
+        long long sum = 0;
+        for (int b = 0; b < n; ++b)
+            if (mask >> b & 1) sum += scores[b];
+        if (sum > threshold && (best < 0 || sum < best)) best = sum;
+    }
+    return best;
+}
+
+static long long c_combination() {
+    long long failures = 0;
+    const int CASES = 600;
+    for (int c = 0; c < CASES; ++c) {
+        int n = nextRandom(1, 18);
+        int threshold = c % 3 == 0 ? nextRandom(0, 2000) : nextRandom(2000000, 200000000);
+        vector<int> scores(n);
+        for (int i = 0; i < n; ++i) scores[i] = nextRandom(0, 5) == 0 ? 0 : nextRandom(1, 2 * (threshold / n) + 1);
+        vector<int> chosen;
+        bool found = CombinationSelector::selectMinAbove(scores, threshold, chosen);
+        long long expected = bruteForceMinAbove(scores, threshold);
+        long long sum = 0;
+        vector<bool> used(n, false);
+        bool valid = true;
+        for (size_t k = 0; k < chosen.size(); ++k) {
+            if (chosen[k] < 0 || chosen[k] >= n || used[chosen[k]]) { valid = false; break; }
+            used[chosen[k]] = true;
+            sum += scores[chosen[k]];
+        }
+        if (found != (expected >= 0) || !valid || (found && sum != expected)) failures++;
+    }
+    report("combination", CASES, failures);
+    return failures;
+}
+
+// ---------------------- lane kernel vs scalar scoring ----------------------
+// Quantities sweep from small values past the range the lane arithmetic is
+// exact for, so both the lanes and the scalar fallback are exercised. Each
+// tier caps weights and unit counts so no score or total overflows an int.
+// Some units carry terrain modifiers or are neutralized; every score must be
+// the unit's effective score and the totals what updateLF_EXP sums.
+struct ScoreTier {
+    int quantityLimit, maxWeight, maxUnits;
+};
+
+static long long c_score_lanes() {
+    static const ScoreTier TIERS[] = {
+        { 100, 200, 300 }, { 40000, 100, 300 }, { 3000000, 100, 3 }, { 60000000, 10, 1 }
+    };
+    long long failures = 0;
+    const int CASES = 400;
+    for (int n = 0; n < CASES; ++n) {
+        const ScoreTier &tier = TIERS[n % 4];
+        vector<Unit*> units;
+        ArmyScoreView view;
+        for (int i = nextRandom(1, tier.maxUnits); i > 0; --i) {
+            Unit *u = randomUnit(1, tier.maxWeight, Position());
+            u->setQuantity(nextRandom(-tier.quantityLimit, tier.quantityLimit));
+            if (nextRandom(0, 2) == 0) u->addTerrainModifier(nextRandom(-300, 300));
+            if (nextRandom(0, 9) == 0) u->neutralize();
+            units.push_back(u);
+            view.add(u);
+        }
+        int lf, exp, scalarLF, scalarEXP, expectedLF = 0, expectedEXP = 0;
+        view.computeScores(lf, exp);
+        vector<int> vehicleScores = view.getVehicleScores(), infantryScores = view.getInfantryScores();
+        view.computeScoresScalar(scalarLF, scalarEXP);
+        bool same = vehicleScores == view.getVehicleScores() && infantryScores == view.getInfantryScores();
+        size_t v = 0, i = 0;
+        for (Unit *u : units) {
+            int score = u->getEffectiveScore();
+            if (u->getKind() == VEHICLE_UNIT) {
+                expectedLF += score;
+                same = same && vehicleScores[v++] == score;
+            } else {
+                expectedEXP += score;
+                same = same && infantryScores[i++] == score;
+            }
+        }
+        if (!same || lf != scalarLF || exp != scalarEXP || lf != expectedLF || exp != expectedEXP) failures++;
+        for (Unit *u : units) delete u;
+    }
+    report("score_lanes", CASES, failures);
+    return failures;
+}
+
+int main(int argc, const char * argv[]) {
+    static const char *CHECKS[] = { "remove_if", "snapshot", "confiscation", "capacity", "pipeline", "combination", "score_lanes" };
+    const int CHECK_COUNT = 7;
+    vector<bool> selected(CHECK_COUNT, argc == 1);
+    for (int a = 1; a < argc; ++a) {
+        int k = 0;
+        while (k < CHECK_COUNT && string(argv[a]) != CHECKS[k]) ++k;
+        if (k == CHECK_COUNT) {
+            cerr << "usage: check [remove_if|snapshot|confiscation|capacity|pipeline|combination|score_lanes]..." << endl;
+            return 2;
+        }
+        selected[k] = true;
+    }
+    vector<string> scenarios = checkScenarios();
+    long long failures = 0;
+    cout << "check,cases,failures" << endl;
+    if (selected[0]) failures += c_remove_if();
+    if (selected[1]) failures += c_snapshot(scenarios);
+    if (selected[2]) failures += c_confiscation();
+    if (selected[3]) failures += c_capacity();
+    if (selected[4]) failures += c_pipeline(scenarios);
+    if (selected[5]) failures += c_combination();
+    if (selected[6]) failures += c_score_lanes();
+    return failures == 0 ? 0 : 1;
+}
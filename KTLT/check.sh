@@ -0,0 +1,2 @@
+g++ -O2 -o check check.cpp scenario_generator.cpp hcmcampaign.cpp -I . -std=c++11
+./check "$@"
\ No newline at end of file
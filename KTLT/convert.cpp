@@ -0,0 +1,31 @@
+// Compiles a text config into the binary scenario format (.hcmb) and checks
+// that it loads back to the same Configuration. Build and run with convert.sh.
+// A config with problems is reported on stderr and not converted.
+//   convert CONFIG.txt OUT.hcmb
+
+#include "scenario_binary.h"
+
+using namespace std;
+
+int main(int argc, const char * argv[]) {
+    if (argc != 3) {
+        cerr << "usage: convert CONFIG.txt OUT.hcmb" << endl;
+        return 2;
+    }
+    Configuration text(argv[1]);
+    const vector<string> &diagnostics = text.getDiagnostics();
+    for (size_t i = 0; i < diagnostics.size(); ++i) cerr << argv[1] << ": " << diagnostics[i] << endl;
+    if (!diagnostics.empty()) return 1;
+    if (!ScenarioBinary::convert(argv[1], argv[2])) {
+        cerr << "cannot convert " << argv[1] << " to " << argv[2] << endl;
+        return 1;
+    }
+    Configuration *binary = ScenarioBinary::load(argv[2]);
+    bool same = binary && binary->str() == text.str();
+    delete binary;
+    if (!same) {
+        cerr << argv[2] << " does not load back to the same configuration" << endl;
+        return 1;
+    }
+    return 0;
+}
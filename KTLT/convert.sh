@@ -0,0 +1,2 @@
+g++ -O2 -o convert convert.cpp scenario_binary.cpp hcmcampaign.cpp -I . -std=c++11
+./convert "$@"
@@ -8,6 +8,75 @@
 
 using namespace std;
 
+// ====================== Instrumentation ==========================
+#ifdef HCM_INSTRUMENT
+thread_local CampaignStats *CampaignStats::current = nullptr;
+
+CampaignStats::CampaignStats() : insertMerges(0), insertAppends(0), unitAllocations(0), scoreDeltas(0) {
+    for (int s = 0; s < STAGE_COUNT; ++s) calls[s] = nanos[s] = allocations[s] = 0;
+}
+void CampaignStats::add(const CampaignStats &other) {
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        calls[s] += other.calls[s];
+        nanos[s] += other.nanos[s];
+        allocations[s] += other.allocations[s];
+    }
+    insertMerges += other.insertMerges;
+    insertAppends += other.insertAppends;
+    unitAllocations += other.unitAllocations;
+    scoreDeltas += other.scoreDeltas;
+}
+string CampaignStats::report() const {
+    static const char *STAGE_NAMES[STAGE_COUNT] = {
+        "terrain", "liberation_fight", "arvn_fight", "remove_weak_units"
+    };
+    ostringstream oss;
+    oss << "stage,calls,ms,unit_allocations\n";
+    for (int s = 0; s < STAGE_COUNT; ++s)
+        oss << STAGE_NAMES[s] << "," << calls[s] << "," << fixed << setprecision(3) << nanos[s] / 1e6
+            << "," << allocations[s] << "\n";
+    oss << "insert_merges," << insertMerges << "\ninsert_appends," << insertAppends
+        << "\nunit_allocations," << unitAllocations << "\nscore_deltas," << scoreDeltas << "\n";
+    return oss.str();
+}
+
+// Makes a campaign's stats current for the enclosing scope.
+class StatsScope {
+public:
+    StatsScope(CampaignStats &stats) : saved(CampaignStats::current) { CampaignStats::current = &stats; }
+    ~StatsScope() { CampaignStats::current = saved; }
+private:
+    CampaignStats *saved;
+};
+
+// Charges the enclosing scope's time and unit allocations to one stage.
+class StageTimer {
+public:
+    StageTimer(CampaignStats::Stage stage)
+        : stats(CampaignStats::current), stage(stage), start(stats ? CampaignStats::clockNanos() : 0),
+          allocationsBefore(stats ? stats->unitAllocations : 0) {}
+    ~StageTimer() {
+        if (!stats) return;
+        stats->calls[stage]++;
+        stats->nanos[stage] += CampaignStats::clockNanos() - start;
+        stats->allocations[stage] += stats->unitAllocations - allocationsBefore;
+    }
+private:
+    CampaignStats *stats;
+    CampaignStats::Stage stage;
+    long long start;
+    long long allocationsBefore;
+};
+
+#define HCM_STATS_SCOPE(stats) StatsScope hcmStatsScope(stats)
+#define HCM_STAGE(stage) StageTimer hcmStageTimer(CampaignStats::stage)
+#define HCM_COUNT(counter) do { if (CampaignStats::current) CampaignStats::current->counter++; } while (0)
+#else
+#define HCM_STATS_SCOPE(stats) ((void)0)
+#define HCM_STAGE(stage) ((void)0)
+#define HCM_COUNT(counter) ((void)0)
+#endif
+
 // ====================== Position ==========================
 Position::Position(int r, int c) : r(r), c(c) {}
 Position::Position(const string &str_pos) {
@@ -18,383 +87,1645 @@ int Position::getCol() const { return c; }
 void Position::setRow(int r) { this->r = r; }
 void Position::setCol(int c) { this->c = c; }
 string Position::str() const {
-    ostringstream oss;
-    oss << "(" << r << "," << c << ")";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
+}
+// Decimal digits written back to front into a small buffer; no stream or
+// locale is involved.
+static void appendInt(string &out, int value) {
+    char buf[12];
+    char *p = buf + sizeof(buf);
+    unsigned int v = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do { *--p = (char)('0' + v % 10); v /= 10; } while (v);
+    if (value < 0) *--p = '-';
+    out.append(p, buf + sizeof(buf) - p);
+}
+void Position::appendTo(string &out) const {
+    out += '(';
+    appendInt(out, r);
+    out += ',';
+    appendInt(out, c);
+    out += ')';
+}
+
+// ====================== ScoreEngine ==========================
+int ScoreEngine::vehicleScore(int vehicleType, int quantity, int weight) {
+    return vehicleType * 304 + (int)ceil((double)quantity * weight / 30.0);
+}
+int ScoreEngine::infantryScore(int infantryType, int quantity, int weight) {
+    int score = infantryType * 56 + quantity * weight;
+    if (infantryType == SPECIALFORCES) {
+        int sq = (int)sqrt(weight);
+        if (sq * sq == weight) score += 75;
+    }
+    return score;
+}
+// Repeated digit sums of n >= 10 end at its digital root, 1 + (n - 1) % 9;
+// smaller values (only reachable with negative scores) are left as they are.
+int ScoreEngine::personalNumber(int score) {
+    int y = 1975, n = score + y;
+    return n < 10 ? n : 1 + (n - 1) % 9;
+}
+// How a personal number in [0, 9] changes the quantity: -1 scales it down to
+// 90%, +1 up to 120%, 0 keeps it. Anything below 0 scales down.
+static constexpr signed char QUANTITY_ADJUSTMENT[10] = { -1, -1, -1, 0, 0, 0, 0, 0, 1, 1 };
+int ScoreEngine::adjustedQuantity(int infantryType, int quantity, int weight) {
+    int n = personalNumber(infantryScore(infantryType, quantity, weight));
+    int adjustment = n < 0 ? -1 : QUANTITY_ADJUSTMENT[n];
+    if (adjustment > 0) return (int)ceil(quantity * 1.2);
+    if (adjustment < 0) return (int)floor(quantity * 0.9);
+    return quantity;
+}
+
+// Bit n of the table is set when n is special; built at compile time over
+// [0, SPECIAL_LIMIT], which covers LF (<= 1000) + EXP (<= 500).
+static const int SPECIAL_LIMIT = 1500;
+static constexpr bool hasBinaryDigits(int n, int base) {
+    return n == 0 || (n % base <= 1 && hasBinaryDigits(n / base, base));
+}
+static constexpr bool specialByDigits(int n) {
+    return hasBinaryDigits(n, 3) || hasBinaryDigits(n, 5) || hasBinaryDigits(n, 7);
+}
+static constexpr unsigned long long specialWord(int word, int bit = 0) {
+    return bit == 64 ? 0ULL
+         : ((specialByDigits(word * 64 + bit) ? 1ULL << bit : 0ULL) | specialWord(word, bit + 1));
+}
+#define SPECIAL_WORDS_4(w) specialWord(w), specialWord(w + 1), specialWord(w + 2), specialWord(w + 3)
+static constexpr unsigned long long SPECIAL_TABLE[] = {
+    SPECIAL_WORDS_4(0), SPECIAL_WORDS_4(4), SPECIAL_WORDS_4(8),
+    SPECIAL_WORDS_4(12), SPECIAL_WORDS_4(16), SPECIAL_WORDS_4(20)
+};
+#undef SPECIAL_WORDS_4
+static_assert(sizeof(SPECIAL_TABLE) * 8 > SPECIAL_LIMIT, "special-number table too small");
+static_assert(specialByDigits(10) && specialByDigits(26) && !specialByDigits(2), "special-number digits");
+
+bool ScoreEngine::isSpecialNumber(int n) {
+    if (n < 0) return false;
+    if (n <= SPECIAL_LIMIT) return SPECIAL_TABLE[n >> 6] >> (n & 63) & 1;
+    return specialByDigits(n);
+}
+int ScoreEngine::listCapacity(int strength) {
+    return isSpecialNumber(strength) ? 12 : 8;
+}
+
+// ====================== CombinationSelector ==========================
+// Above this many DP cells (items x threshold) the search switches to
+// meet-in-the-middle, which is only used while 2^(n/2) stays small.
+static const long long DP_CELL_LIMIT = 1LL << 24;
+static const int MEET_IN_MIDDLE_MAX_ITEMS = 44;
+
+bool CombinationSelector::selectMinAbove(const vector<int> &scores, int threshold, vector<int> &chosen) {
+    chosen.clear();
+    if (threshold < 0) threshold = 0;
+    long long cells = (long long)(scores.size() + 1) * (threshold + 1);
+    if (cells > DP_CELL_LIMIT && (int)scores.size() <= MEET_IN_MIDDLE_MAX_ITEMS)
+        return selectByMeetInMiddle(scores, threshold, chosen);
+    return selectByDP(scores, threshold, chosen);
+}
+// In a minimal subset, dropping its last item (by index) leaves a sum
+// <= threshold, so it is enough to track reachable sums up to threshold
+// and try every item as the one that crosses it.
+bool CombinationSelector::selectByDP(const vector<int> &scores, int threshold, vector<int> &chosen) {
+    int n = scores.size(), width = threshold + 1;
+    vector<char> reach((size_t)(n + 1) * width, 0);
+    reach[0] = 1;
+    long long best = -1;
+    int bestItem = -1, bestBase = 0;
+    for (int i = 0; i < n; ++i) {
+        const char *row = &reach[(size_t)i * width];
+        char *next = &reach[(size_t)(i + 1) * width];
+        int w = scores[i];
+        for (int s = 0; s < width; ++s) {
+            if (!row[s]) continue;
+            next[s] = 1;
+            if (w <= 0) continue;
+            long long total = (long long)s + w;
+            if (total > threshold) {
+                if (best < 0 || total < best) { best = total; bestItem = i; bestBase = s; }
+            } else {
+                next[total] = 1;
+            }
+        }
+    }
+    if (bestItem < 0) return false;
+    chosen.push_back(bestItem);
+    for (int i = bestItem, s = bestBase; i > 0 && s > 0; --i) {
+        if (reach[(size_t)(i - 1) * width + s]) continue;
+        chosen.push_back(i - 1);
+        s -= scores[i - 1];
+    }
+    reverse(chosen.begin(), chosen.end());
+    return true;
+}
+bool CombinationSelector::selectByMeetInMiddle(const vector<int> &scores, int threshold, vector<int> &chosen) {
+    vector<int> items;
+    for (int i = 0; i < (int)scores.size(); ++i)
+        if (scores[i] > 0) items.push_back(i);
+    int n = items.size(), lowCount = n / 2, highCount = n - lowCount;
+
+    vector<pair<long long, long long> > high((size_t)1 << highCount);
+    for (long long mask = 0; mask < (1LL << highCount); ++mask) {
+        long long sum = 0;
+        for (int b = 0; b < highCount; ++b)
+            if (mask >> b & 1) sum += scores[items[lowCount + b]];
+        high[mask] = make_pair(sum, mask);
+    }
+    sort(high.begin(), high.end());
+
+    long long best = -1, bestLow = 0, bestHigh = 0;
+    for (long long mask = 0; mask < (1LL << lowCount); ++mask) {
+        long long sum = 0;
+        for (int b = 0; b < lowCount; ++b)
+            if (mask >> b & 1) sum += scores[items[b]];
+        vector<pair<long long, long long> >::iterator it =
+            upper_bound(high.begin(), high.end(), make_pair(threshold - sum, LLONG_MAX));
+        if (it == high.end()) continue;
+        if (best < 0 || sum + it->first < best) {
+            best = sum + it->first; bestLow = mask; bestHigh = it->second;
+        }
+    }
+    if (best < 0) return false;
+    for (int b = 0; b < lowCount; ++b)
+        if (bestLow >> b & 1) chosen.push_back(items[b]);
+    for (int b = 0; b < highCount; ++b)
+        if (bestHigh >> b & 1) chosen.push_back(items[lowCount + b]);
+    return true;
 }
 
 // ====================== Unit (Abstract) ======================
 Unit::Unit(int quantity, int weight, Position pos)
-    : quantity(quantity), weight(weight), pos(pos) {}
+    : Unit(quantity, weight, pos, UNKNOWN_UNIT) {}
+Unit::Unit(int quantity, int weight, Position pos, UnitKind kind)
+    : quantity(quantity), weight(weight), pos(pos), kind(kind),
+      baseQuantity(quantity), score(0), scoreValid(false), terrainModifier(0), neutralized(false),
+      owner(nullptr) {}
+// Copies start out unowned but keep their terrain modifier.
+Unit::Unit(const Unit &other)
+    : quantity(other.quantity), weight(other.weight), pos(other.pos), kind(other.kind),
+      baseQuantity(other.baseQuantity), score(other.score), scoreValid(other.scoreValid),
+      terrainModifier(other.terrainModifier), neutralized(other.neutralized), owner(nullptr) {}
 Unit::~Unit() {}
 Position Unit::getCurrentPosition() const { return pos; }
+UnitKind Unit::getKind() const { return kind; }
 int Unit::getQuantity() const { return quantity; }
 int Unit::getWeight() const { return weight; }
-void Unit::setQuantity(int q) { quantity = q; }
-void Unit::setWeight(int w) { weight = w; }
+void Unit::setQuantity(int q) {
+    quantity = baseQuantity = q;
+    invalidateScore();
+}
+void Unit::setWeight(int w) {
+    weight = w;
+    invalidateScore();
+}
+void Unit::invalidateScore() {
+    bool wasValid = scoreValid;
+    scoreValid = false;
+    if (owner && wasValid) owner->unitScoreChanged(this, effectiveOf(score));
+}
+int Unit::effectiveOf(int attackScore) const {
+    if (neutralized) return 0;
+    return max(0, attackScore + terrainModifier);
+}
+int Unit::getEffectiveScore() { return effectiveOf(getAttackScore()); }
+int Unit::evaluateEffectiveScore() const { return effectiveOf(evaluateAttackScore()); }
+int Unit::getTerrainModifier() const { return terrainModifier; }
+bool Unit::isNeutralized() const { return neutralized; }
+void Unit::addTerrainModifier(int delta) {
+    int before = evaluateEffectiveScore();
+    terrainModifier += delta;
+    if (owner) owner->unitScoreChanged(this, before);
+}
+void Unit::neutralize() {
+    int before = evaluateEffectiveScore();
+    neutralized = true;
+    if (owner) owner->unitScoreChanged(this, before);
+}
 
 // ====================== Vehicle ==========================
 Vehicle::Vehicle(int quantity, int weight, const Position pos, VehicleType vehicleType)
-    : Unit(quantity, weight, pos), vehicleType(vehicleType) {}
+    : Unit(quantity, weight, pos, VEHICLE_UNIT), vehicleType(vehicleType) {}
 int Vehicle::getAttackScore() {
-    return vehicleType * 304 + (int)ceil((double)quantity * weight / 30.0);
+    if (!scoreValid) {
+        score = ScoreEngine::vehicleScore(vehicleType, quantity, weight);
+        scoreValid = true;
+    }
+    return score;
+}
+int Vehicle::evaluateAttackScore() const {
+    if (scoreValid) return score;
+    return ScoreEngine::vehicleScore(vehicleType, quantity, weight);
 }
 string Vehicle::str() const {
-    ostringstream oss;
-    oss << "Vehicle[vehicleType=" << vehicleType
-        << ",quantity=" << quantity
-        << ",weight=" << weight
-        << ",pos=" << pos.str() << "]";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
+}
+void Vehicle::appendTo(string &out) const {
+    out += "Vehicle[vehicleType=";
+    appendInt(out, vehicleType);
+    out += ",quantity=";
+    appendInt(out, quantity);
+    out += ",weight=";
+    appendInt(out, weight);
+    out += ",pos=";
+    pos.appendTo(out);
+    out += ']';
 }
+Unit* Vehicle::clone() const { return new Vehicle(*this); }
 VehicleType Vehicle::getVehicleType() const { return vehicleType; }
 
 // ====================== Infantry ==========================
 Infantry::Infantry(int quantity, int weight, const Position pos, InfantryType infantryType)
-    : Unit(quantity, weight, pos), infantryType(infantryType) {}
+    : Unit(quantity, weight, pos, INFANTRY_UNIT), infantryType(infantryType) {}
+// The personal-number adjustment is applied to baseQuantity once per
+// quantity/weight change, so repeated calls return the same score.
 int Infantry::getAttackScore() {
-    int score = infantryType * 56 + quantity * weight;
-    if (infantryType == SPECIALFORCES) {
-        int sq = (int)sqrt(weight);
-        if (sq * sq == weight) score += 75;
-    }
-    int y = 1975, n = score + y;
-    while (n >= 10) {
-        int s = 0, t = n;
-        while (t) { s += t % 10; t /= 10; }
-        n = s;
-    }
-    if (n > 7) quantity = (int)ceil(quantity * 1.2);
-    if (n < 3) quantity = (int)floor(quantity * 0.9);
-    // Re-calc score
-    score = infantryType * 56 + quantity * weight;
-    if (infantryType == SPECIALFORCES) {
-        int sq = (int)sqrt(weight);
-        if (sq * sq == weight) score += 75;
+    if (!scoreValid) {
+        quantity = ScoreEngine::adjustedQuantity(infantryType, baseQuantity, weight);
+        score = ScoreEngine::infantryScore(infantryType, quantity, weight);
+        scoreValid = true;
     }
     return score;
 }
+int Infantry::evaluateAttackScore() const {
+    if (scoreValid) return score;
+    int q = ScoreEngine::adjustedQuantity(infantryType, baseQuantity, weight);
+    return ScoreEngine::infantryScore(infantryType, q, weight);
+}
 string Infantry::str() const {
-    ostringstream oss;
-    oss << "Infantry[infantryType=" << infantryType
-        << ",quantity=" << quantity
-        << ",weight=" << weight
-        << ",pos=" << pos.str() << "]";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
+}
+void Infantry::appendTo(string &out) const {
+    out += "Infantry[infantryType=";
+    appendInt(out, infantryType);
+    out += ",quantity=";
+    appendInt(out, quantity);
+    out += ",weight=";
+    appendInt(out, weight);
+    out += ",pos=";
+    pos.appendTo(out);
+    out += ']';
 }
+Unit* Infantry::clone() const { return new Infantry(*this); }
 InfantryType Infantry::getInfantryType() const { return infantryType; }
 
+// ====================== UnitPool ==========================
+UnitPool::UnitPool() : vehiclesInLastBlock(BLOCK_UNITS), infantryInLastBlock(BLOCK_UNITS) {}
+UnitPool::~UnitPool() {
+    destroy(vehicleBlocks, vehiclesInLastBlock);
+    destroy(infantryBlocks, infantryInLastBlock);
+}
+// A released unit is still a live object; the placement new in newVehicle /
+// newInfantry / copy simply constructs over it.
+template <class T> void *UnitPool::allocate(vector<T*> &blocks, int &usedInLast, vector<T*> &freeList) {
+    HCM_COUNT(unitAllocations);
+    if (!freeList.empty()) {
+        T *recycled = freeList.back();
+        freeList.pop_back();
+        return recycled;
+    }
+    if (usedInLast == BLOCK_UNITS) {
+        blocks.push_back(static_cast<T*>(::operator new(sizeof(T) * BLOCK_UNITS)));
+        usedInLast = 0;
+    }
+    return blocks.back() + usedInLast++;
+}
+template <class T> void UnitPool::destroy(vector<T*> &blocks, int usedInLast) {
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        int used = b + 1 == blocks.size() ? usedInLast : BLOCK_UNITS;
+        for (int i = 0; i < used; ++i) blocks[b][i].~T();
+        ::operator delete(blocks[b]);
+    }
+    blocks.clear();
+}
+Vehicle *UnitPool::newVehicle(int quantity, int weight, const Position &pos, VehicleType vehicleType) {
+    return new (allocate(vehicleBlocks, vehiclesInLastBlock, freeVehicles)) Vehicle(quantity, weight, pos, vehicleType);
+}
+Infantry *UnitPool::newInfantry(int quantity, int weight, const Position &pos, InfantryType infantryType) {
+    return new (allocate(infantryBlocks, infantryInLastBlock, freeInfantry)) Infantry(quantity, weight, pos, infantryType);
+}
+Unit *UnitPool::copy(const Unit *unit) {
+    if (unit->getKind() == VEHICLE_UNIT)
+        return new (allocate(vehicleBlocks, vehiclesInLastBlock, freeVehicles)) Vehicle(*static_cast<const Vehicle*>(unit));
+    if (unit->getKind() == INFANTRY_UNIT)
+        return new (allocate(infantryBlocks, infantryInLastBlock, freeInfantry)) Infantry(*static_cast<const Infantry*>(unit));
+    return nullptr;
+}
+void UnitPool::release(Unit *unit) {
+    if (unit->getKind() == VEHICLE_UNIT) freeVehicles.push_back(static_cast<Vehicle*>(unit));
+    else if (unit->getKind() == INFANTRY_UNIT) freeInfantry.push_back(static_cast<Infantry*>(unit));
+}
+int UnitPool::getUnitCount() const {
+    int vehicles = vehicleBlocks.empty() ? 0 : (vehicleBlocks.size() - 1) * BLOCK_UNITS + vehiclesInLastBlock;
+    int infantry = infantryBlocks.empty() ? 0 : (infantryBlocks.size() - 1) * BLOCK_UNITS + infantryInLastBlock;
+    return vehicles + infantry - (int)(freeVehicles.size() + freeInfantry.size());
+}
+
 // ====================== UnitList ==========================
-UnitList::UnitList(int capacity)
-    : capacity(capacity), head(nullptr), count_vehicle(0), count_infantry(0) {}
+UnitList::UnitList(int capacity, UnitPool *pool)
+    : capacity(capacity), count_vehicle(0), count_infantry(0), army(nullptr), pool(pool) {
+    for (int i = 0; i < NUM_VEHICLE_TYPES; ++i) vehicleSlot[i] = nullptr;
+    for (int i = 0; i < NUM_INFANTRY_TYPES; ++i) infantrySlot[i] = nullptr;
+}
 UnitList::~UnitList() {
-    Node *cur = head;
-    while (cur) {
-        Node *tmp = cur;
-        cur = cur->next;
-        delete tmp->data;
-        delete tmp;
-    }
+    if (pool) return;
+    for (Unit *unit : *this) delete unit;
 }
+// The list keeps its own copy of every unit it adopts; the caller keeps
+// ownership of the unit passed in.
 bool UnitList::insert(Unit *unit) {
-    Vehicle *v = dynamic_cast<Vehicle*>(unit);
-    Infantry *i = dynamic_cast<Infantry*>(unit);
-
-    Node *cur = head;
-    while (cur) {
-        if (v && dynamic_cast<Vehicle*>(cur->data) && ((Vehicle*)cur->data)->getVehicleType() == v->getVehicleType()) {
-            cur->data->setQuantity(cur->data->getQuantity() + v->getQuantity());
-            delete v;
-            return true;
+    Unit **slot = nullptr;
+    if (unit->getKind() == VEHICLE_UNIT)
+        slot = &vehicleSlot[static_cast<Vehicle*>(unit)->getVehicleType()];
+    else if (unit->getKind() == INFANTRY_UNIT)
+        slot = &infantrySlot[static_cast<Infantry*>(unit)->getInfantryType()];
+    else return false;
+
+    // A merged unit stays where the unit already in the list stands, so it
+    // keeps that unit's neutralization but takes on the newcomer's modifier.
+    if (*slot) {
+        HCM_COUNT(insertMerges);
+        (*slot)->setQuantity((*slot)->getQuantity() + unit->getQuantity());
+        if (unit->terrainModifier) (*slot)->addTerrainModifier(unit->terrainModifier);
+        return true;
+    }
+    if (getTotalCount() >= capacity) return false;
+    HCM_COUNT(insertAppends);
+    if (!pool) HCM_COUNT(unitAllocations);
+    Unit *copy = pool ? pool->copy(unit) : unit->clone();
+    *slot = copy;
+    copy->owner = this;
+    if (copy->getKind() == VEHICLE_UNIT) units[NUM_INFANTRY_TYPES + count_vehicle++] = copy;
+    else units[NUM_INFANTRY_TYPES - ++count_infantry] = copy;
+    if (army) army->applyScoreDelta(copy->getKind(), copy->getEffectiveScore());
+    return true;
+}
+// Replays insert() on plain numbers. An appended unit is scored at once, so
+// an infantry unit's quantity takes the personal-number adjustment of its
+// base quantity; a merge adds the newcomer's current quantity, keeps the
+// first weight and is scored (and adjusted) again.
+int UnitList::capacityFor(Unit *const *units, int size) {
+    const Unit *first[NUM_VEHICLE_TYPES + NUM_INFANTRY_TYPES] = {};
+    int quantity[NUM_VEHICLE_TYPES + NUM_INFANTRY_TYPES] = {};
+    for (int i = 0; i < size; ++i) {
+        const Unit *u = units[i];
+        int slot;
+        if (u->getKind() == VEHICLE_UNIT) slot = static_cast<const Vehicle*>(u)->getVehicleType();
+        else if (u->getKind() == INFANTRY_UNIT) slot = NUM_VEHICLE_TYPES + static_cast<const Infantry*>(u)->getInfantryType();
+        else continue;
+        int q = first[slot] ? quantity[slot] + u->getQuantity() : u->baseQuantity;
+        if (!first[slot]) first[slot] = u;
+        quantity[slot] = slot < NUM_VEHICLE_TYPES ? q
+                       : ScoreEngine::adjustedQuantity(slot - NUM_VEHICLE_TYPES, q, first[slot]->getWeight());
+    }
+    int lf = 0, exp = 0;
+    for (int slot = 0; slot < NUM_VEHICLE_TYPES + NUM_INFANTRY_TYPES; ++slot) {
+        if (!first[slot]) continue;
+        if (slot < NUM_VEHICLE_TYPES) lf += ScoreEngine::vehicleScore(slot, quantity[slot], first[slot]->getWeight());
+        else exp += ScoreEngine::infantryScore(slot - NUM_VEHICLE_TYPES, quantity[slot], first[slot]->getWeight());
+    }
+    return ScoreEngine::listCapacity(max(0, min(lf, 1000)) + max(0, min(exp, 500)));
+}
+int UnitList::getCapacity() const { return capacity; }
+void UnitList::setCapacity(int capacity) { this->capacity = capacity; }
+// Scores passed around here are effective scores.
+void UnitList::unitScoreChanged(Unit *unit, int oldScore) {
+    int newScore = unit->getEffectiveScore();
+    if (army) army->applyScoreDelta(unit->getKind(), newScore - oldScore);
+}
+// Unlinks a unit without freeing it; its score leaves the army's sums.
+bool UnitList::detach(Unit *unit) {
+    int front = NUM_INFANTRY_TYPES - count_infantry;
+    int end = NUM_INFANTRY_TYPES + count_vehicle;
+    int at = front;
+    while (at < end && units[at] != unit) ++at;
+    if (at == end) return false;
+
+    if (unit->getKind() == VEHICLE_UNIT) {
+        for (int i = at; i + 1 < end; ++i) units[i] = units[i + 1];
+        vehicleSlot[static_cast<Vehicle*>(unit)->getVehicleType()] = nullptr;
+        count_vehicle--;
+    } else {
+        for (int i = at; i > front; --i) units[i] = units[i - 1];
+        infantrySlot[static_cast<Infantry*>(unit)->getInfantryType()] = nullptr;
+        count_infantry--;
+    }
+    unit->owner = nullptr;
+    if (army) army->applyScoreDelta(unit->getKind(), -unit->getEffectiveScore());
+    return true;
+}
+// Second half of removeIf: the removed units are already out of units[].
+void UnitList::releaseRemoved(Unit **removed, int count) {
+    int lfDelta = 0, expDelta = 0;
+    for (int i = 0; i < count; ++i) {
+        Unit *unit = removed[i];
+        if (unit->getKind() == VEHICLE_UNIT) {
+            vehicleSlot[static_cast<Vehicle*>(unit)->getVehicleType()] = nullptr;
+            lfDelta -= unit->getEffectiveScore();
+        } else {
+            infantrySlot[static_cast<Infantry*>(unit)->getInfantryType()] = nullptr;
+            expDelta -= unit->getEffectiveScore();
         }
-        if (i && dynamic_cast<Infantry*>(cur->data) && ((Infantry*)cur->data)->getInfantryType() == i->getInfantryType()) {
-            cur->data->setQuantity(cur->data->getQuantity() + i->getQuantity());
-            delete i;
-            return true;
+        unit->owner = nullptr;
+    }
+    if (army) army->applyScoreDelta(lfDelta, expDelta);
+    for (int i = 0; i < count; ++i) {
+        if (pool) pool->release(removed[i]);
+        else delete removed[i];
+    }
+}
+bool UnitList::remove(Unit *unit) {
+    if (!detach(unit)) return false;
+    if (pool) pool->release(unit);
+    else delete unit;
+    return true;
+}
+void UnitList::saveTo(Snapshot &snapshot) const {
+    snapshot.capacity = capacity;
+    snapshot.count_vehicle = count_vehicle;
+    snapshot.count_infantry = count_infantry;
+    for (int i = 0; i < getTotalCount(); ++i) {
+        const Unit *unit = getUnitAt(i);
+        UnitRecord &r = snapshot.units[i];
+        r.kind = unit->kind;
+        r.type = unit->kind == VEHICLE_UNIT ? (int)static_cast<const Vehicle*>(unit)->getVehicleType()
+                                            : (int)static_cast<const Infantry*>(unit)->getInfantryType();
+        r.quantity = unit->quantity;
+        r.baseQuantity = unit->baseQuantity;
+        r.weight = unit->weight;
+        r.row = unit->pos.getRow();
+        r.col = unit->pos.getCol();
+        r.score = unit->score;
+        r.scoreValid = unit->scoreValid;
+        r.terrainModifier = unit->terrainModifier;
+        r.neutralized = unit->neutralized;
+    }
+}
+// Army sums are restored separately, so no score deltas are reported here.
+void UnitList::restoreFrom(const Snapshot &snapshot) {
+    Unit *oldVehicles[NUM_VEHICLE_TYPES], *oldInfantry[NUM_INFANTRY_TYPES];
+    for (int t = 0; t < NUM_VEHICLE_TYPES; ++t) { oldVehicles[t] = vehicleSlot[t]; vehicleSlot[t] = nullptr; }
+    for (int t = 0; t < NUM_INFANTRY_TYPES; ++t) { oldInfantry[t] = infantrySlot[t]; infantrySlot[t] = nullptr; }
+
+    capacity = snapshot.capacity;
+    count_vehicle = snapshot.count_vehicle;
+    count_infantry = snapshot.count_infantry;
+    for (int i = 0; i < getTotalCount(); ++i) {
+        const UnitRecord &r = snapshot.units[i];
+        Position pos(r.row, r.col);
+        Unit *unit;
+        if (r.kind == VEHICLE_UNIT) {
+            unit = oldVehicles[r.type];
+            oldVehicles[r.type] = nullptr;
+            if (!unit) unit = pool ? pool->newVehicle(r.quantity, r.weight, pos, (VehicleType)r.type)
+                                   : new Vehicle(r.quantity, r.weight, pos, (VehicleType)r.type);
+            vehicleSlot[r.type] = unit;
+        } else {
+            unit = oldInfantry[r.type];
+            oldInfantry[r.type] = nullptr;
+            if (!unit) unit = pool ? pool->newInfantry(r.quantity, r.weight, pos, (InfantryType)r.type)
+                                   : new Infantry(r.quantity, r.weight, pos, (InfantryType)r.type);
+            infantrySlot[r.type] = unit;
         }
-        cur = cur->next;
+        unit->quantity = r.quantity;
+        unit->baseQuantity = r.baseQuantity;
+        unit->weight = r.weight;
+        unit->pos = pos;
+        unit->score = r.score;
+        unit->scoreValid = r.scoreValid;
+        unit->terrainModifier = r.terrainModifier;
+        unit->neutralized = r.neutralized;
+        unit->owner = this;
+        units[NUM_INFANTRY_TYPES - count_infantry + i] = unit;
     }
 
-    if (v) {
-        Node **tail = &head;
-        while (*tail) tail = &((*tail)->next);
-        *tail = new Node(unit);
-        count_vehicle++;
-    } else if (i) {
-        Node *n = new Node(unit);
-        n->next = head;
-        head = n;
-        count_infantry++;
+    for (int t = 0; t < NUM_VEHICLE_TYPES; ++t) {
+        if (!oldVehicles[t]) continue;
+        if (pool) pool->release(oldVehicles[t]);
+        else delete oldVehicles[t];
+    }
+    for (int t = 0; t < NUM_INFANTRY_TYPES; ++t) {
+        if (!oldInfantry[t]) continue;
+        if (pool) pool->release(oldInfantry[t]);
+        else delete oldInfantry[t];
     }
-    return true;
 }
 bool UnitList::isContain(VehicleType vehicleType) {
-    Node *cur = head;
-    while (cur) {
-        Vehicle *v = dynamic_cast<Vehicle *>(cur->data);
-        if (v && v->getVehicleType() == vehicleType) return true;
-        cur = cur->next;
-    }
-    return false;
+    return vehicleType >= 0 && vehicleType < NUM_VEHICLE_TYPES && vehicleSlot[vehicleType];
 }
 bool UnitList::isContain(InfantryType infantryType) {
-    Node *cur = head;
-    while (cur) {
-        Infantry *i = dynamic_cast<Infantry *>(cur->data);
-        if (i && i->getInfantryType() == infantryType) return true;
-        cur = cur->next;
-    }
-    return false;
+    return infantryType >= 0 && infantryType < NUM_INFANTRY_TYPES && infantrySlot[infantryType];
 }
 string UnitList::str() const {
-    ostringstream oss;
-    oss << "UnitList[count_vehicle=" << count_vehicle
-        << ";count_infantry=" << count_infantry << ";";
-    Node *cur = head;
+    string out;
+    appendTo(out);
+    return out;
+}
+void UnitList::appendTo(string &out) const {
+    out += "UnitList[count_vehicle=";
+    appendInt(out, count_vehicle);
+    out += ";count_infantry=";
+    appendInt(out, count_infantry);
+    out += ';';
     bool first = true;
-    while (cur) {
-        if (!first) oss << ",";
-        oss << cur->data->str();
+    for (const Unit *unit : *this) {
+        if (!first) out += ',';
+        unit->appendTo(out);
         first = false;
-        cur = cur->next;
     }
-    oss << "]";
-    return oss.str();
+    out += ']';
 }
 int UnitList::getCountVehicle() const { return count_vehicle; }
 int UnitList::getCountInfantry() const { return count_infantry; }
 int UnitList::getTotalCount() const { return count_vehicle + count_infantry; }
 Unit* UnitList::getUnitAt(int idx) const {
-    Node *cur = head;
-    int cnt = 0;
-    while (cur) {
-        if (cnt == idx) return cur->data;
-        cnt++;
-        cur = cur->next;
+    if (idx < 0 || idx >= getTotalCount()) return nullptr;
+    return units[NUM_INFANTRY_TYPES - count_infantry + idx];
+}
+UnitList::const_iterator UnitList::begin() const { return units + NUM_INFANTRY_TYPES - count_infantry; }
+UnitList::const_iterator UnitList::end() const { return units + NUM_INFANTRY_TYPES + count_vehicle; }
+UnitSpan UnitList::view() const { return UnitSpan(begin(), getTotalCount()); }
+
+UnitSpan::UnitSpan(Unit *const *first, int count) : first(first), count(count) {}
+UnitSpan::iterator UnitSpan::begin() const { return first; }
+UnitSpan::iterator UnitSpan::end() const { return first + count; }
+int UnitSpan::size() const { return count; }
+bool UnitSpan::empty() const { return count == 0; }
+Unit *UnitSpan::operator[](int idx) const { return first[idx]; }
+void UnitList::removeIfAttackScoreLE5() {
+    HCM_STAGE(REMOVE_WEAK_UNITS);
+    removeIf([](Unit *unit) { return unit->getEffectiveScore() <= 5; });
+}
+
+// ====================== ArmyScoreView ==========================
+// The lane kernel replaces every floating-point step of ScoreEngine with an
+// integer one that agrees with it exactly while |quantity| <= 5e7 and
+// |quantity * weight| stays below 2^30:
+//   ceil(q*w / 30.0)  -> ceilDiv(q*w, 30)
+//   ceil(q * 1.2)     -> ceilDiv(6q, 5)
+//   floor(q * 0.9)    -> floorDiv(9q, 10)
+//   digit sum loop    -> n < 10 ? n : 1 + (n - 1) % 9
+// The special-forces perfect-square bonus depends only on type and weight,
+// so it is worked out once in add(). Terrain is applied last, as in
+// Unit::effectiveOf.
+static const long long LANE_MAX_QUANTITY = 50000000;
+static const long long LANE_MAX_PRODUCT = 1LL << 30;
+
+static int effectiveScore(int attackScore, int modifier, int neutralized) {
+    return neutralized ? 0 : max(0, attackScore + modifier);
+}
+
+ArmyScoreView::ArmyScoreView() : needsScalar(false) {}
+void ArmyScoreView::clear() {
+    vehicleType.clear(); vehicleQuantity.clear(); vehicleWeight.clear();
+    vehicleModifier.clear(); vehicleNeutralized.clear(); vehicleScore.clear();
+    infantryType.clear(); infantryQuantity.clear(); infantryWeight.clear(); infantryBonus.clear();
+    infantryModifier.clear(); infantryNeutralized.clear(); infantryScore.clear();
+    needsScalar = false;
+}
+void ArmyScoreView::add(const Unit *unit) {
+    long long product = (long long)unit->baseQuantity * unit->weight;
+    if (unit->baseQuantity > LANE_MAX_QUANTITY || unit->baseQuantity < -LANE_MAX_QUANTITY
+        || product >= LANE_MAX_PRODUCT || product <= -LANE_MAX_PRODUCT)
+        needsScalar = true;
+    if (unit->getKind() == VEHICLE_UNIT) {
+        vehicleType.push_back(static_cast<const Vehicle*>(unit)->getVehicleType());
+        vehicleQuantity.push_back(unit->quantity);
+        vehicleWeight.push_back(unit->weight);
+        vehicleModifier.push_back(unit->terrainModifier);
+        vehicleNeutralized.push_back(unit->neutralized);
+    } else if (unit->getKind() == INFANTRY_UNIT) {
+        int type = static_cast<const Infantry*>(unit)->getInfantryType();
+        infantryType.push_back(type);
+        infantryQuantity.push_back(unit->baseQuantity);
+        infantryWeight.push_back(unit->weight);
+        infantryBonus.push_back(ScoreEngine::infantryScore(type, 0, unit->weight) - type * 56);
+        infantryModifier.push_back(unit->terrainModifier);
+        infantryNeutralized.push_back(unit->neutralized);
     }
-    return nullptr;
 }
-void UnitList::removeIfAttackScoreLE5() {}
+void ArmyScoreView::addAll(const UnitList *list) {
+    for (const Unit *unit : *list) add(unit);
+}
+int ArmyScoreView::getVehicleCount() const { return vehicleType.size(); }
+int ArmyScoreView::getInfantryCount() const { return infantryType.size(); }
+const vector<int>& ArmyScoreView::getVehicleScores() const { return vehicleScore; }
+const vector<int>& ArmyScoreView::getInfantryScores() const { return infantryScore; }
 
-// ====================== BattleField (optional for now) ==========================
+void ArmyScoreView::computeScoresScalar(int &LF, int &EXP) {
+    LF = 0; EXP = 0;
+    vehicleScore.resize(vehicleType.size());
+    infantryScore.resize(infantryType.size());
+    for (size_t i = 0; i < vehicleType.size(); ++i) {
+        int score = ScoreEngine::vehicleScore(vehicleType[i], vehicleQuantity[i], vehicleWeight[i]);
+        vehicleScore[i] = effectiveScore(score, vehicleModifier[i], vehicleNeutralized[i]);
+        LF += vehicleScore[i];
+    }
+    for (size_t i = 0; i < infantryType.size(); ++i) {
+        int q = ScoreEngine::adjustedQuantity(infantryType[i], infantryQuantity[i], infantryWeight[i]);
+        int score = ScoreEngine::infantryScore(infantryType[i], q, infantryWeight[i]);
+        infantryScore[i] = effectiveScore(score, infantryModifier[i], infantryNeutralized[i]);
+        EXP += infantryScore[i];
+    }
+}
+
+#if defined(__GNUC__)
+typedef int IntLanes __attribute__((vector_size(16)));
+typedef unsigned UIntLanes __attribute__((vector_size(16)));
+static const int LANES = sizeof(IntLanes) / sizeof(int);
+
+static IntLanes loadLanes(const int *p) {
+    IntLanes v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+static void storeLanes(int *p, IntLanes v) { memcpy(p, &v, sizeof(v)); }
+// Comparisons give all-ones lanes where true, so select is a bitwise blend.
+static IntLanes selectLanes(IntLanes mask, IntLanes a, IntLanes b) { return (mask & a) | (~mask & b); }
+static IntLanes ceilDivLanes(IntLanes x, int d) {
+    IntLanes zero = {0, 0, 0, 0};
+    return selectLanes(x >= zero, (x + (d - 1)) / d, x / d);
+}
+static IntLanes floorDivLanes(IntLanes x, int d) {
+    IntLanes zero = {0, 0, 0, 0};
+    return selectLanes(x >= zero, x / d, -((-x + (d - 1)) / d));
+}
+static IntLanes effectiveLanes(IntLanes score, const int *modifier, const int *neutralized) {
+    IntLanes zero = {0, 0, 0, 0};
+    IntLanes s = score + loadLanes(modifier);
+    return selectLanes((s > zero) & (loadLanes(neutralized) == zero), s, zero);
+}
+#endif
+
+void ArmyScoreView::computeScores(int &LF, int &EXP) {
+#if defined(__GNUC__)
+    if (needsScalar) {
+        computeScoresScalar(LF, EXP);
+        return;
+    }
+    size_t nv = vehicleType.size(), ni = infantryType.size();
+    vehicleScore.resize(nv);
+    infantryScore.resize(ni);
+    // Totals are summed unsigned so that overflow wraps instead of being undefined.
+    UIntLanes lf = {0, 0, 0, 0}, exp = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + LANES <= nv; i += LANES) {
+        IntLanes s = loadLanes(&vehicleType[i]) * 304
+                   + ceilDivLanes(loadLanes(&vehicleQuantity[i]) * loadLanes(&vehicleWeight[i]), 30);
+        s = effectiveLanes(s, &vehicleModifier[i], &vehicleNeutralized[i]);
+        storeLanes(&vehicleScore[i], s);
+        lf += (UIntLanes)s;
+    }
+    unsigned lfTail = 0, expTail = 0;
+    for (; i < nv; ++i) {
+        int score = ScoreEngine::vehicleScore(vehicleType[i], vehicleQuantity[i], vehicleWeight[i]);
+        vehicleScore[i] = effectiveScore(score, vehicleModifier[i], vehicleNeutralized[i]);
+        lfTail += vehicleScore[i];
+    }
+    for (i = 0; i + LANES <= ni; i += LANES) {
+        IntLanes base = loadLanes(&infantryType[i]) * 56 + loadLanes(&infantryBonus[i]);
+        IntLanes q = loadLanes(&infantryQuantity[i]);
+        IntLanes w = loadLanes(&infantryWeight[i]);
+        IntLanes n = base + q * w + 1975;
+        IntLanes personal = selectLanes(n < 10, n, 1 + (n - 1) % 9);
+        IntLanes adjusted = selectLanes(personal > 7, ceilDivLanes(q * 6, 5),
+                                        selectLanes(personal < 3, floorDivLanes(q * 9, 10), q));
+        IntLanes s = effectiveLanes(base + adjusted * w, &infantryModifier[i], &infantryNeutralized[i]);
+        storeLanes(&infantryScore[i], s);
+        exp += (UIntLanes)s;
+    }
+    for (; i < ni; ++i) {
+        int q = ScoreEngine::adjustedQuantity(infantryType[i], infantryQuantity[i], infantryWeight[i]);
+        int score = ScoreEngine::infantryScore(infantryType[i], q, infantryWeight[i]);
+        infantryScore[i] = effectiveScore(score, infantryModifier[i], infantryNeutralized[i]);
+        expTail += infantryScore[i];
+    }
+    LF = (int)(lf[0] + lf[1] + lf[2] + lf[3] + lfTail);
+    EXP = (int)(exp[0] + exp[1] + exp[2] + exp[3] + expTail);
+#else
+    computeScoresScalar(LF, EXP);
+#endif
+}
+
+// ====================== DistanceTable ==========================
+static constexpr double DISTANCE[DistanceTable::MAX_RADIUS * DistanceTable::MAX_RADIUS + 1] = {
+    0.0, 1.0, 1.4142135623730951, 1.7320508075688772, 2.0, 2.23606797749979, 2.449489742783178,
+    2.6457513110645907, 2.8284271247461903, 3.0, 3.1622776601683795, 3.3166247903554, 3.4641016151377544,
+    3.605551275463989, 3.7416573867739413, 3.872983346207417, 4.0, 4.123105625617661, 4.242640687119285,
+    4.358898943540674, 4.47213595499958, 4.58257569495584, 4.69041575982343, 4.795831523312719,
+    4.898979485566356, 5.0
+};
+
+double DistanceTable::distance(long long dist2) {
+    if (dist2 >= 0 && dist2 <= MAX_RADIUS * MAX_RADIUS) return DISTANCE[dist2];
+    return sqrt((double)dist2);
+}
+
+// ====================== TerrainElement ==========================
+// Percentages round up, like every computed value in the campaign:
+// scaleUp(v, 90) is ceil(90% of v).
+static int scaleUp(int value, int percent) {
+    return (int)(((long long)value * percent + 99) / 100);
+}
+TerrainElement::TerrainElement() : pos(0, 0) {}
+TerrainElement::TerrainElement(const Position &pos) : pos(pos) {}
+TerrainElement::~TerrainElement() {}
+Position TerrainElement::getPosition() const { return pos; }
+bool TerrainElement::neutralizes() const { return false; }
+void TerrainElement::affect(const Army *army, Unit *unit, long long dist2) const {
+    if (neutralizes()) {
+        unit->neutralize();
+        return;
+    }
+    int delta = unitEffect(army, unit, dist2);
+    if (delta) unit->addTerrainModifier(delta);
+}
+void TerrainElement::applyEffect(Army *army) const {
+    if (!army) return;
+    int radius = effectRadius(army);
+    if (radius < 0) return;
+    UnitList *list = army->getUnitList();
+    for (Unit *u : *list) {
+        long long dr = u->getCurrentPosition().getRow() - pos.getRow();
+        long long dc = u->getCurrentPosition().getCol() - pos.getCol();
+        long long dist2 = dr * dr + dc * dc;
+        if (dist2 <= (long long)radius * radius) affect(army, u, dist2);
+    }
+}
+
+Road::Road(const Position &pos) : TerrainElement(pos) {}
+void Road::getEffect(Army *army) {}
+int Road::effectRadius(const Army *army) const { return -1; }
+int Road::unitEffect(const Army *army, const Unit *unit, long long dist2) const { return 0; }
+
+Mountain::Mountain(const Position &pos) : TerrainElement(pos) {}
+void Mountain::getEffect(Army *army) { applyEffect(army); }
+int Mountain::effectRadius(const Army *army) const { return army->isLiberationArmy() ? 2 : 4; }
+int Mountain::unitEffect(const Army *army, const Unit *unit, long long dist2) const {
+    bool liberation = army->isLiberationArmy();
+    int score = unit->evaluateAttackScore();
+    if (unit->getKind() == INFANTRY_UNIT) return scaleUp(score, liberation ? 30 : 20);
+    if (unit->getKind() == VEHICLE_UNIT) return -scaleUp(score, liberation ? 10 : 5);
+    return 0;
+}
+
+River::River(const Position &pos) : TerrainElement(pos) {}
+void River::getEffect(Army *army) { applyEffect(army); }
+int River::effectRadius(const Army *army) const { return 2; }
+int River::unitEffect(const Army *army, const Unit *unit, long long dist2) const {
+    if (unit->getKind() == INFANTRY_UNIT) return -scaleUp(unit->evaluateAttackScore(), 10);
+    return 0;
+}
+
+// A unit standing on the urban cell itself (D = 0) gets no distance bonus.
+Urban::Urban(const Position &pos) : TerrainElement(pos) {}
+void Urban::getEffect(Army *army) { applyEffect(army); }
+int Urban::effectRadius(const Army *army) const { return army->isLiberationArmy() ? 5 : 3; }
+int Urban::unitEffect(const Army *army, const Unit *unit, long long dist2) const {
+    int score = unit->evaluateAttackScore();
+    if (unit->getKind() == INFANTRY_UNIT) {
+        InfantryType type = static_cast<const Infantry*>(unit)->getInfantryType();
+        if (dist2 == 0) return 0;
+        double d = DistanceTable::distance(dist2);
+        if (army->isLiberationArmy() && (type == SPECIALFORCES || type == REGULARINFANTRY))
+            return (int)ceil(2.0 * score / d);
+        if (!army->isLiberationArmy() && type == REGULARINFANTRY)
+            return (int)ceil(3.0 * score / (2.0 * d));
+    } else if (unit->getKind() == VEHICLE_UNIT && army->isLiberationArmy()) {
+        if (static_cast<const Vehicle*>(unit)->getVehicleType() == ARTILLERY && dist2 <= 4)
+            return -scaleUp(score, 50);
+    }
+    return 0;
+}
+
+Fortification::Fortification(const Position &pos) : TerrainElement(pos) {}
+void Fortification::getEffect(Army *army) { applyEffect(army); }
+int Fortification::effectRadius(const Army *army) const { return 2; }
+int Fortification::unitEffect(const Army *army, const Unit *unit, long long dist2) const {
+    int delta = scaleUp(unit->evaluateAttackScore(), 20);
+    return army->isLiberationArmy() ? -delta : delta;
+}
+
+SpecialZone::SpecialZone(const Position &pos) : TerrainElement(pos) {}
+void SpecialZone::getEffect(Army *army) { applyEffect(army); }
+int SpecialZone::effectRadius(const Army *army) const { return 1; }
+// Reduces units in range to 0 outright; overlapping zones change nothing more.
+int SpecialZone::unitEffect(const Army *army, const Unit *unit, long long dist2) const { return 0; }
+bool SpecialZone::neutralizes() const { return true; }
+
+// ====================== UnitSpatialIndex ==========================
+UnitSpatialIndex::UnitSpatialIndex(int n_rows, int n_cols)
+    : bucketRows(max(1, (n_rows + BUCKET_SIZE - 1) / BUCKET_SIZE)),
+      bucketCols(max(1, (n_cols + BUCKET_SIZE - 1) / BUCKET_SIZE)) {}
+// Off-map positions land in the nearest edge bucket; clamping the query
+// square the same way keeps them reachable.
+int UnitSpatialIndex::bucketRow(int r) const {
+    return r < 0 ? 0 : min(bucketRows - 1, r / BUCKET_SIZE);
+}
+int UnitSpatialIndex::bucketCol(int c) const {
+    return c < 0 ? 0 : min(bucketCols - 1, c / BUCKET_SIZE);
+}
+void UnitSpatialIndex::clear() { entries.clear(); }
+void UnitSpatialIndex::add(const Army *army) {
+    if (!army) return;
+    UnitList *list = army->getUnitList();
+    for (Unit *unit : *list) {
+        Entry e;
+        e.unit = unit;
+        e.r = e.unit->getCurrentPosition().getRow();
+        e.c = e.unit->getCurrentPosition().getCol();
+        e.bucket = (long long)bucketRow(e.r) * bucketCols + bucketCol(e.c);
+        e.army = army;
+        entries.push_back(e);
+    }
+}
+void UnitSpatialIndex::build() {
+    stable_sort(entries.begin(), entries.end());
+}
+void UnitSpatialIndex::query(const Army *army, int r, int c, int radius, vector<Unit*> &out) const {
+    long long radius2 = (long long)radius * radius;
+    int rowFrom = bucketRow(r - radius), rowTo = bucketRow(r + radius);
+    int colFrom = bucketCol(c - radius), colTo = bucketCol(c + radius);
+    for (int br = rowFrom; br <= rowTo; ++br) {
+        Entry probe;
+        probe.bucket = (long long)br * bucketCols + colFrom;
+        long long last = (long long)br * bucketCols + colTo;
+        vector<Entry>::const_iterator it = lower_bound(entries.begin(), entries.end(), probe);
+        for (; it != entries.end() && it->bucket <= last; ++it) {
+            if (it->army != army) continue;
+            long long dr = it->r - r, dc = it->c - c;
+            if (dr * dr + dc * dc <= radius2) out.push_back(it->unit);
+        }
+    }
+}
+int UnitSpatialIndex::size() const { return entries.size(); }
+
+// ====================== TerrainGrid ==========================
+static int popcount64(unsigned long long word) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    int n = 0;
+    for (; word; word &= word - 1) ++n;
+    return n;
+#endif
+}
+TerrainGrid::TerrainGrid() : n_rows(0), n_cols(0), sparse(false) {}
+void TerrainGrid::build(int n_rows, int n_cols, const vector<Position> *terrain) {
+    this->n_rows = max(0, n_rows);
+    this->n_cols = max(0, n_cols);
+    long long cells = (long long)this->n_rows * this->n_cols;
+    size_t placed = 0;
+    for (int t = FOREST; t <= SPECIAL_ZONE; ++t) placed += terrain[t].size();
+    size_t slots = 16;
+    while (slots < 2 * placed) slots *= 2;
+    long long denseBytes = PLANES * ((cells + 63) / 64) * (long long)sizeof(unsigned long long);
+    long long sparseBytes = slots * (long long)(sizeof(long long) + sizeof(unsigned char));
+    sparse = sparseBytes < denseBytes;
+    keys.clear();
+    types.clear();
+    for (int p = 0; p < PLANES; ++p) planes[p].clear();
+    if (sparse) {
+        keys.assign(slots, -1);
+        types.assign(slots, ROAD);
+    } else {
+        for (int p = 0; p < PLANES; ++p) planes[p].assign((cells + 63) / 64, 0);
+    }
+    for (int t = FOREST; t <= SPECIAL_ZONE; ++t)
+        for (size_t i = 0; i < terrain[t].size(); ++i) {
+            long long cell = cellOf(terrain[t][i].getRow(), terrain[t][i].getCol());
+            if (cell >= 0) set(cell, (TerrainType)t);
+        }
+}
+long long TerrainGrid::cellOf(int r, int c) const {
+    if (r < 0 || c < 0 || r >= n_rows || c >= n_cols) return -1;
+    return (long long)r * n_cols + c;
+}
+// Fibonacci hashing; the table is a power of two at most half full.
+size_t TerrainGrid::slotOf(long long cell) const {
+    size_t mask = keys.size() - 1;
+    size_t slot = (size_t)(((unsigned long long)cell * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (keys[slot] != -1 && keys[slot] != cell) slot = (slot + 1) & mask;
+    return slot;
+}
+void TerrainGrid::set(long long cell, TerrainType type) {
+    if (sparse) {
+        size_t slot = slotOf(cell);
+        keys[slot] = cell;
+        types[slot] = type;
+        return;
+    }
+    unsigned long long bit = 1ULL << (cell & 63);
+    for (int p = 0; p < PLANES; ++p) {
+        if (type >> p & 1) planes[p][cell >> 6] |= bit;
+        else planes[p][cell >> 6] &= ~bit;
+    }
+}
+bool TerrainGrid::isSparse() const { return sparse; }
+TerrainType TerrainGrid::terrainAt(int r, int c) const {
+    long long cell = cellOf(r, c);
+    if (cell < 0) return ROAD;
+    if (sparse) {
+        size_t slot = slotOf(cell);
+        return keys[slot] == cell ? (TerrainType)types[slot] : ROAD;
+    }
+    int type = 0;
+    for (int p = 0; p < PLANES; ++p) type |= (int)(planes[p][cell >> 6] >> (cell & 63) & 1) << p;
+    return (TerrainType)type;
+}
+// Cells in [from, to] whose three plane bits spell type, a word at a time.
+int TerrainGrid::countDense(long long from, long long to, TerrainType type) const {
+    int count = 0;
+    for (long long w = from >> 6; w <= to >> 6; ++w) {
+        unsigned long long match = ~0ULL;
+        for (int p = 0; p < PLANES; ++p) match &= (type >> p & 1) ? planes[p][w] : ~planes[p][w];
+        if (w == from >> 6) match &= ~0ULL << (from & 63);
+        if (w == to >> 6 && (to & 63) != 63) match &= (1ULL << ((to & 63) + 1)) - 1;
+        count += popcount64(match);
+    }
+    return count;
+}
+long long TerrainGrid::countInRect(TerrainType type, int rowFrom, int colFrom, int rowTo, int colTo) const {
+    rowFrom = max(rowFrom, 0);
+    colFrom = max(colFrom, 0);
+    rowTo = min(rowTo, n_rows - 1);
+    colTo = min(colTo, n_cols - 1);
+    if (rowFrom > rowTo || colFrom > colTo) return 0;
+    long long count = 0;
+    if (!sparse) {
+        for (int r = rowFrom; r <= rowTo; ++r)
+            count += countDense(cellOf(r, colFrom), cellOf(r, colTo), type);
+        return count;
+    }
+    // Only non-road cells are stored, so roads are the rest of the rectangle.
+    long long stored = 0;
+    for (size_t slot = 0; slot < keys.size(); ++slot) {
+        if (keys[slot] == -1) continue;
+        int r = keys[slot] / n_cols, c = keys[slot] % n_cols;
+        if (r < rowFrom || r > rowTo || c < colFrom || c > colTo) continue;
+        ++stored;
+        if (types[slot] == type) ++count;
+    }
+    if (type != ROAD) return count;
+    return (long long)(rowTo - rowFrom + 1) * (colTo - colFrom + 1) - stored;
+}
+size_t TerrainGrid::memoryBytes() const {
+    size_t bytes = keys.capacity() * sizeof(long long) + types.capacity();
+    for (int p = 0; p < PLANES; ++p) bytes += planes[p].capacity() * sizeof(unsigned long long);
+    return bytes;
+}
+
+// ====================== BattleField ==========================
+static void copyPositions(const vector<Position *> &from, vector<Position> &to) {
+    to.reserve(from.size());
+    for (size_t i = 0; i < from.size(); ++i)
+        if (from[i]) to.push_back(*from[i]);
+}
 BattleField::BattleField(int n_rows, int n_cols, vector<Position *> arrayForest,
                          vector<Position *> arrayRiver, vector<Position *> arrayFortification,
                          vector<Position *> arrayUrban, vector<Position *> arraySpecialZone)
-    : n_rows(n_rows), n_cols(n_cols) {}
-BattleField::~BattleField() {}
+    : n_rows(n_rows), n_cols(n_cols), unitIndex(n_rows, n_cols) {
+    copyPositions(arrayForest, terrain[FOREST]);
+    copyPositions(arrayRiver, terrain[RIVER]);
+    copyPositions(arrayFortification, terrain[FORTIFICATION]);
+    copyPositions(arrayUrban, terrain[URBAN]);
+    copyPositions(arraySpecialZone, terrain[SPECIAL_ZONE]);
+    for (size_t i = 0; i < terrain[FOREST].size(); ++i) elements.push_back(new Mountain(terrain[FOREST][i]));
+    for (size_t i = 0; i < terrain[RIVER].size(); ++i) elements.push_back(new River(terrain[RIVER][i]));
+    for (size_t i = 0; i < terrain[FORTIFICATION].size(); ++i) elements.push_back(new Fortification(terrain[FORTIFICATION][i]));
+    for (size_t i = 0; i < terrain[URBAN].size(); ++i) elements.push_back(new Urban(terrain[URBAN][i]));
+    for (size_t i = 0; i < terrain[SPECIAL_ZONE].size(); ++i) elements.push_back(new SpecialZone(terrain[SPECIAL_ZONE][i]));
+    grid.build(n_rows, n_cols, terrain);
+}
+BattleField::~BattleField() {
+    for (size_t i = 0; i < elements.size(); ++i) delete elements[i];
+}
 string BattleField::str() const {
-    ostringstream oss;
-    oss << "BattleField[n_rows=" << n_rows << ",n_cols=" << n_cols << "]";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
+}
+void BattleField::appendTo(string &out) const {
+    out += "BattleField[n_rows=";
+    appendInt(out, n_rows);
+    out += ",n_cols=";
+    appendInt(out, n_cols);
+    out += ']';
 }
 int BattleField::getRows() const { return n_rows; }
 int BattleField::getCols() const { return n_cols; }
+const vector<Position>& BattleField::getTerrainPositions(TerrainType type) const {
+    return terrain[type];
+}
+TerrainType BattleField::terrainAt(int r, int c) const { return grid.terrainAt(r, c); }
+TerrainType BattleField::terrainAt(const Position &pos) const { return grid.terrainAt(pos.getRow(), pos.getCol()); }
+long long BattleField::countTerrain(TerrainType type, int rowFrom, int colFrom, int rowTo, int colTo) const {
+    return grid.countInRect(type, rowFrom, colFrom, rowTo, colTo);
+}
+const TerrainGrid& BattleField::getTerrainGrid() const { return grid; }
+void BattleField::indexUnits(Army *first, Army *second) {
+    unitIndex.clear();
+    unitIndex.add(first);
+    unitIndex.add(second);
+    unitIndex.build();
+}
+void BattleField::unitsWithin(const Army *army, const Position &center, int radius, vector<Unit*> &out) const {
+    unitIndex.query(army, center.getRow(), center.getCol(), radius, out);
+}
+const vector<TerrainElement*>& BattleField::getTerrainElements() const { return elements; }
+// Same result as calling every element's getEffect on both armies, but each
+// element only visits nearby units.
+void BattleField::applyTerrainEffects(Army *first, Army *second) {
+    indexUnits(first, second);
+    Army *armies[2] = { first, second };
+    vector<Unit*> nearby;
+    for (int a = 0; a < 2; ++a) {
+        Army *army = armies[a];
+        if (!army) continue;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            const TerrainElement *e = elements[i];
+            int radius = e->effectRadius(army);
+            if (radius < 0) continue;
+            Position center = e->getPosition();
+            nearby.clear();
+            unitsWithin(army, center, radius, nearby);
+            for (size_t k = 0; k < nearby.size(); ++k) {
+                long long dr = nearby[k]->getCurrentPosition().getRow() - center.getRow();
+                long long dc = nearby[k]->getCurrentPosition().getCol() - center.getCol();
+                e->affect(army, nearby[k], dr * dr + dc * dc);
+            }
+        }
+    }
+}
 
 // ====================== Army / LiberationArmy / ARVN ==========================
-Army::Army(Unit **unitArray, int size, string name, BattleField *battleField)
-    : LF(0), EXP(0), name(name), unitList(new UnitList(size)), battleField(battleField) {
+int ConfiscationTally::total() const {
+    int sum = 0;
+    for (int t = 0; t <= TANK; ++t) sum += vehicles[t];
+    for (int t = 0; t <= REGULARINFANTRY; ++t) sum += infantry[t];
+    return sum;
+}
+void ConfiscationTally::add(const ConfiscationTally &other) {
+    for (int t = 0; t <= TANK; ++t) vehicles[t] += other.vehicles[t];
+    for (int t = 0; t <= REGULARINFANTRY; ++t) infantry[t] += other.infantry[t];
+}
+
+Army::Army(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool)
+    : LF(0), EXP(0), name(name),
+      unitList(new UnitList(UnitList::capacityFor(unitArray, size), pool)), battleField(battleField), defeated(false),
+      confiscated() {
+    unitList->army = this;
     for (int i = 0; i < size; ++i) unitList->insert(unitArray[i]);
-    updateLF_EXP();
 }
 Army::~Army() { delete unitList; }
-int Army::getLF() const { return LF; }
-int Army::getEXP() const { return EXP; }
+void Army::appendArmy(string &out, const char *label) const {
+    out += label;
+    out += "[name=";
+    out += name;
+    out += ",LF=";
+    appendInt(out, getLF());
+    out += ",EXP=";
+    appendInt(out, getEXP());
+    out += ',';
+    unitList->appendTo(out);
+    out += ']';
+}
+void Army::saveTo(ArmySnapshot &snapshot) const {
+    snapshot.LF = LF;
+    snapshot.EXP = EXP;
+    snapshot.defeated = defeated;
+    snapshot.confiscated = confiscated;
+    unitList->saveTo(snapshot.units);
+}
+void Army::restoreFrom(const ArmySnapshot &snapshot) {
+    unitList->restoreFrom(snapshot.units);
+    LF = snapshot.LF;
+    EXP = snapshot.EXP;
+    defeated = snapshot.defeated;
+    confiscated = snapshot.confiscated;
+}
+int Army::getLF() const {
+    return LF < 0 ? 0 : (LF > 1000 ? 1000 : LF);
+}
+int Army::getEXP() const {
+    return EXP < 0 ? 0 : (EXP > 500 ? 500 : EXP);
+}
+bool Army::isLiberationArmy() const { return false; }
 string Army::getName() const { return name; }
 UnitList* Army::getUnitList() const { return unitList; }
+const ConfiscationTally &Army::getConfiscated() const { return confiscated; }
 void Army::updateLF_EXP() {
     LF = 0; EXP = 0;
-    UnitList::Node* cur = unitList->head;
-    while (cur) {
-        Vehicle* v = dynamic_cast<Vehicle*>(cur->data);
-        Infantry* i = dynamic_cast<Infantry*>(cur->data);
-        if (v) LF += v->getAttackScore();
-        if (i) EXP += i->getAttackScore();
-        cur = cur->next;
+    for (Unit *u : *unitList) {
+        if (u->getKind() == VEHICLE_UNIT) LF += u->getEffectiveScore();
+        else if (u->getKind() == INFANTRY_UNIT) EXP += u->getEffectiveScore();
     }
-    if (LF > 1000) LF = 1000;
-    if (EXP > 500) EXP = 500;
 }
+bool Army::findCombination(UnitKind kind, int threshold, vector<Unit*> &combination) const {
+    vector<Unit*> candidates;
+    vector<int> scores, chosen;
+    for (Unit *u : *unitList) {
+        if (u->getKind() != kind) continue;
+        candidates.push_back(u);
+        scores.push_back(u->evaluateEffectiveScore());
+    }
+    combination.clear();
+    if (!CombinationSelector::selectMinAbove(scores, threshold, chosen)) return false;
+    for (size_t i = 0; i < chosen.size(); ++i) combination.push_back(candidates[chosen[i]]);
+    return true;
+}
+void Army::removeUnits(const vector<Unit*> &units) {
+    unitList->removeIf([&units](Unit *unit) { return find(units.begin(), units.end(), unit) != units.end(); });
+}
+void Army::removeUnitsOfKind(UnitKind kind) {
+    unitList->removeIf([kind](Unit *unit) { return unit->getKind() == kind; });
+}
+// Takes over every unit of the enemy; types we already have are merged. A
+// unit that does not fit the list is lost with the enemy and not counted.
+void Army::confiscate(Army *enemy) {
+    UnitList *spoils = enemy->unitList;
+    for (Unit *u : *spoils) {
+        if (!unitList->insert(u)) continue;
+        if (u->getKind() == VEHICLE_UNIT) confiscated.vehicles[static_cast<Vehicle*>(u)->getVehicleType()]++;
+        else confiscated.infantry[static_cast<Infantry*>(u)->getInfantryType()]++;
+    }
+    spoils->removeIf([](Unit *) { return true; });
+    enemy->defeated = true;
+}
+void Army::scaleQuantities(int percent) {
+    for (Unit *u : *unitList) u->setQuantity(scaleUp(u->getQuantity(), percent));
+}
+void Army::scaleWeights(int percent) {
+    for (Unit *u : *unitList) u->setWeight(scaleUp(u->getWeight(), percent));
+}
+void Army::applyScoreDelta(UnitKind kind, int delta) {
+    if (kind == VEHICLE_UNIT) applyScoreDelta(delta, 0);
+    else if (kind == INFANTRY_UNIT) applyScoreDelta(0, delta);
+}
+void Army::applyScoreDelta(int lfDelta, int expDelta) {
+    HCM_COUNT(scoreDeltas);
+    LF += lfDelta;
+    EXP += expDelta;
+#ifdef HCM_DEBUG_LF_EXP
+    // Cross-check the running sums against a full rescan of the list.
+    int lf = 0, exp = 0;
+    for (const Unit *u : *unitList) {
+        if (u->getKind() == VEHICLE_UNIT) lf += u->evaluateEffectiveScore();
+        else if (u->getKind() == INFANTRY_UNIT) exp += u->evaluateEffectiveScore();
+    }
+    assert(lf == LF && exp == EXP);
+#endif
+}
+
+LiberationArmy::LiberationArmy(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool)
+    : Army(unitArray, size, name, battleField, pool) {}
+bool LiberationArmy::isLiberationArmy() const { return true; }
+void LiberationArmy::fight(Army *enemy, bool defense) {
+    if (!enemy) return;
+    if (defense) defend(enemy);
+    else attack(enemy);
+}
+void LiberationArmy::attack(Army *enemy) {
+    int lf = min(1000, scaleUp(getLF(), 150));
+    int exp = min(500, scaleUp(getEXP(), 150));
+
+    vector<Unit*> infantryCombo, vehicleCombo;
+    bool foundA = findCombination(INFANTRY_UNIT, enemy->getEXP(), infantryCombo);
+    bool foundB = findCombination(VEHICLE_UNIT, enemy->getLF(), vehicleCombo);
+
+    bool won = false;
+    if (foundA && foundB) {
+        removeUnits(infantryCombo);
+        removeUnits(vehicleCombo);
+        won = true;
+    } else if (foundA && lf > enemy->getLF()) {
+        removeUnits(infantryCombo);
+        removeUnitsOfKind(VEHICLE_UNIT);
+        won = true;
+    } else if (foundB && exp > enemy->getEXP()) {
+        removeUnits(vehicleCombo);
+        removeUnitsOfKind(INFANTRY_UNIT);
+        won = true;
+    }
 
-LiberationArmy::LiberationArmy(Unit **unitArray, int size, string name, BattleField *battleField)
-    : Army(unitArray, size, name, battleField) {}
-void LiberationArmy::fight(Army *enemy, bool defense) {}
+    if (won) confiscate(enemy);
+    else scaleWeights(90);
+}
+static int nextFibonacci(int n) {
+    int a = 1, b = 1;
+    while (b < n) { int t = a + b; a = b; b = t; }
+    return b;
+}
+void LiberationArmy::defend(Army *enemy) {
+    int lf = min(1000, scaleUp(getLF(), 130));
+    int exp = min(500, scaleUp(getEXP(), 130));
+    bool lowerLF = lf < enemy->getLF(), lowerEXP = exp < enemy->getEXP();
+    if (!lowerLF && !lowerEXP) return;
+
+    if (lowerLF && lowerEXP) {
+        for (Unit *u : *unitList) u->setQuantity(nextFibonacci(u->getQuantity()));
+        lf = min(1000, scaleUp(getLF(), 130));
+        exp = min(500, scaleUp(getEXP(), 130));
+        if (lf >= enemy->getLF() && exp >= enemy->getEXP()) return;
+    }
+    scaleQuantities(90);
+}
 string LiberationArmy::str() const {
-    ostringstream oss;
-    oss << "LiberationArmy[name=" << name
-        << ",LF=" << LF
-        << ",EXP=" << EXP
-        << "," << unitList->str()
-        << "]";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
 }
+void LiberationArmy::appendTo(string &out) const { appendArmy(out, "LiberationArmy"); }
 
-ARVN::ARVN(Unit **unitArray, int size, string name, BattleField *battleField)
-    : Army(unitArray, size, name, battleField) {}
-void ARVN::fight(Army *enemy, bool defense) {}
+ARVN::ARVN(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool)
+    : Army(unitArray, size, name, battleField, pool) {}
+// ARVN's indices never change in battle. Attacking, it always loses: every
+// quantity drops by 20% and units left with a quantity of 1 are disbanded.
+// Defending, it only suffers if the attacker confiscated its units, in which
+// case whatever is left loses 20% of its weight.
+void ARVN::fight(Army *enemy, bool defense) {
+    if (!defense) {
+        scaleQuantities(80);
+        unitList->removeIf([](Unit *unit) { return unit->getQuantity() == 1; });
+        return;
+    }
+    if (!defeated) return;
+    scaleWeights(80);
+    defeated = false;
+}
 string ARVN::str() const {
-    ostringstream oss;
-    oss << "ARVN[name=" << name
-        << ",LF=" << LF
-        << ",EXP=" << EXP
-        << "," << unitList->str()
-        << "]";
-    return oss.str();
+    string out;
+    appendTo(out);
+    return out;
+}
+void ARVN::appendTo(string &out) const { appendArmy(out, "ARVN"); }
+
+// ====================== UnitNameTable ==========================
+struct UnitNameEntry {
+    const char *name;
+    UnitKind kind;
+    int type;
+};
+static constexpr UnitNameEntry UNIT_NAMES[] = {
+    { "TRUCK", VEHICLE_UNIT, TRUCK },
+    { "MORTAR", VEHICLE_UNIT, MORTAR },
+    { "ANTIAIRCRAFT", VEHICLE_UNIT, ANTIAIRCRAFT },
+    { "ARMOREDCAR", VEHICLE_UNIT, ARMOREDCAR },
+    { "APC", VEHICLE_UNIT, APC },
+    { "ARTILLERY", VEHICLE_UNIT, ARTILLERY },
+    { "TANK", VEHICLE_UNIT, TANK },
+    { "SNIPER", INFANTRY_UNIT, SNIPER },
+    { "ANTIAIRCRAFTSQUAD", INFANTRY_UNIT, ANTIAIRCRAFTSQUAD },
+    { "MORTARSQUAD", INFANTRY_UNIT, MORTARSQUAD },
+    { "ENGINEER", INFANTRY_UNIT, ENGINEER },
+    { "SPECIALFORCES", INFANTRY_UNIT, SPECIALFORCES },
+    { "REGULARINFANTRY", INFANTRY_UNIT, REGULARINFANTRY }
+};
+static constexpr int UNIT_NAME_COUNT = sizeof(UNIT_NAMES) / sizeof(UNIT_NAMES[0]);
+static constexpr int UNIT_NAME_BUCKETS = 32;
+
+// (4 * length + 6 * first + last) mod 32 happens to separate all 13 names.
+static constexpr int unitNameHash(const char *name, size_t len) {
+    return (int)((len * 4 + (unsigned char)name[0] * 6 + (unsigned char)name[len - 1]) % UNIT_NAME_BUCKETS);
+}
+static constexpr size_t constLength(const char *s) {
+    return *s ? 1 + constLength(s + 1) : 0;
+}
+static constexpr int entryHash(int i) {
+    return unitNameHash(UNIT_NAMES[i].name, constLength(UNIT_NAMES[i].name));
+}
+static constexpr int entryForBucket(int bucket, int i = 0) {
+    return i == UNIT_NAME_COUNT ? -1 : (entryHash(i) == bucket ? i : entryForBucket(bucket, i + 1));
+}
+static constexpr int namesInBucket(int bucket, int i = 0) {
+    return i == UNIT_NAME_COUNT ? 0 : (entryHash(i) == bucket) + namesInBucket(bucket, i + 1);
+}
+static constexpr bool hashIsPerfect(int bucket = 0) {
+    return bucket == UNIT_NAME_BUCKETS || (namesInBucket(bucket) <= 1 && hashIsPerfect(bucket + 1));
+}
+static_assert(hashIsPerfect(), "unit name hash has collisions");
+
+static constexpr signed char UNIT_NAME_SLOTS[UNIT_NAME_BUCKETS] = {
+    entryForBucket(0), entryForBucket(1), entryForBucket(2), entryForBucket(3),
+    entryForBucket(4), entryForBucket(5), entryForBucket(6), entryForBucket(7),
+    entryForBucket(8), entryForBucket(9), entryForBucket(10), entryForBucket(11),
+    entryForBucket(12), entryForBucket(13), entryForBucket(14), entryForBucket(15),
+    entryForBucket(16), entryForBucket(17), entryForBucket(18), entryForBucket(19),
+    entryForBucket(20), entryForBucket(21), entryForBucket(22), entryForBucket(23),
+    entryForBucket(24), entryForBucket(25), entryForBucket(26), entryForBucket(27),
+    entryForBucket(28), entryForBucket(29), entryForBucket(30), entryForBucket(31)
+};
+
+bool UnitNameTable::lookup(const char *name, size_t len, UnitKind &kind, int &type) {
+    if (len == 0) return false;
+    int slot = UNIT_NAME_SLOTS[unitNameHash(name, len)];
+    if (slot < 0) return false;
+    const UnitNameEntry &e = UNIT_NAMES[slot];
+    if (strncmp(e.name, name, len) != 0 || e.name[len] != '\0') return false;
+    kind = e.kind;
+    type = e.type;
+    return true;
+}
+// UNIT_NAMES lists the vehicle types, then the infantry types, in enum order.
+const char *UnitNameTable::name(UnitKind kind, int type) {
+    return UNIT_NAMES[kind == VEHICLE_UNIT ? type : TANK + 1 + type].name;
 }
 
 // ====================== Configuration (đọc file config.txt thật) ==========================
-static vector<string> splitListStr(const string &arr) {
-    vector<string> res;
-    int depth = 0; string tmp;
-    for (char ch : arr) {
-        if (ch == '(') depth++;
-        if (ch == ')') depth--;
-        if (ch == ',' && depth == 0) {
-            if (!tmp.empty()) res.push_back(tmp);
-            tmp.clear();
-        } else if (ch != '[' && ch != ']') {
-            tmp += ch;
+// Hands out the file one line at a time from a fixed-size read buffer. Only a
+// line that straddles two chunks is copied.
+class ConfigLineReader {
+public:
+    ConfigLineReader(istream &in) : in(in), chunk(CHUNK_SIZE), pos(0), len(0) {}
+    bool next(const char *&begin, const char *&end) {
+        bool carrying = false;
+        carry.clear();
+        while (true) {
+            if (pos == len && !refill()) {
+                if (!carrying) return false;
+                begin = carry.data(); end = begin + carry.size();
+                break;
+            }
+            const char *from = &chunk[pos];
+            const char *nl = (const char *)memchr(from, '\n', len - pos);
+            if (!nl) {
+                carry.append(from, len - pos);
+                carrying = true;
+                pos = len;
+                continue;
+            }
+            pos += nl - from + 1;
+            if (carrying) {
+                carry.append(from, nl - from);
+                begin = carry.data(); end = begin + carry.size();
+            } else {
+                begin = from; end = nl;
+            }
+            break;
+        }
+        if (end > begin && end[-1] == '\r') --end;
+        return true;
+    }
+private:
+    static const size_t CHUNK_SIZE = 1 << 16;
+    istream &in;
+    vector<char> chunk;
+    size_t pos, len;
+    string carry;
+    bool refill() {
+        if (!in) return false;
+        in.read(&chunk[0], chunk.size());
+        len = in.gcount();
+        pos = 0;
+        return len > 0;
+    }
+};
+
+// In-place scanner over one line; every parse* returns false on malformed or
+// out-of-range input.
+struct ConfigCursor {
+    const char *p, *end;
+    void skipSpace() { while (p < end && (*p == ' ' || *p == '\t')) ++p; }
+    bool accept(char ch) {
+        skipSpace();
+        if (p < end && *p == ch) { ++p; return true; }
+        return false;
+    }
+    bool parseInt(int &out) {
+        skipSpace();
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+        if (p == end || *p < '0' || *p > '9') return false;
+        long long v = 0, limit = negative ? -(long long)INT_MIN : INT_MAX;
+        while (p < end && *p >= '0' && *p <= '9') {
+            v = v * 10 + (*p++ - '0');
+            if (v > limit) return false;
+        }
+        out = (int)(negative ? -v : v);
+        return true;
+    }
+    bool parsePosition(int &r, int &c) {
+        return accept('(') && parseInt(r) && accept(',') && parseInt(c) && accept(')');
+    }
+    // Moves past the rest of a list entry, nested parentheses included, and
+    // stops before the ',' or ']' that ends it.
+    void skipEntry() {
+        int depth = 0;
+        for (; p < end; ++p) {
+            if (*p == '(') ++depth;
+            else if (*p == ')') { if (depth > 0) --depth; }
+            else if (depth == 0 && (*p == ',' || *p == ']')) return;
         }
     }
-    if (!tmp.empty()) res.push_back(tmp);
-    return res;
+};
+
+static bool keyIs(const char *key, size_t len, const char *name) {
+    return strlen(name) == len && memcmp(key, name, len) == 0;
 }
-static Position* parsePos(const string& s) {
-    int r, c;
-    sscanf(s.c_str(), "(%d,%d)", &r, &c);
-    return new Position(r, c);
+
+Configuration::Configuration(const string& filepath, UnitPool *pool)
+    : num_rows(0), num_cols(0), liberationUnits(nullptr), liberationUnitsCount(0),
+      ARVNUnits(nullptr), ARVNUnitsCount(0), eventCode(0), pool(pool) {
+    ifstream fin(filepath.c_str(), ios::binary);
+    load(fin);
 }
-Configuration::Configuration(const string& filepath)
+Configuration::Configuration(istream &in, UnitPool *pool)
     : num_rows(0), num_cols(0), liberationUnits(nullptr), liberationUnitsCount(0),
-      ARVNUnits(nullptr), ARVNUnitsCount(0), eventCode(0) {
-    ifstream fin(filepath);
-    string line;
+      ARVNUnits(nullptr), ARVNUnitsCount(0), eventCode(0), pool(pool) {
+    load(in);
+}
+Configuration::Configuration(UnitPool *pool)
+    : num_rows(0), num_cols(0), liberationUnits(nullptr), liberationUnitsCount(0),
+      ARVNUnits(nullptr), ARVNUnitsCount(0), eventCode(0), pool(pool) {}
+void Configuration::load(istream &in) {
+    ConfigLineReader reader(in);
     vector<Unit*> liber, arvn;
-    while (getline(fin, line)) {
-        if (line.find("NUM_ROWS") != string::npos) {
-            num_rows = stoi(line.substr(line.find("=") + 1));
-        }
-        if (line.find("NUM_COLS") != string::npos) {
-            num_cols = stoi(line.substr(line.find("=") + 1));
-        }
-        if (line.find("EVENT_CODE") != string::npos) {
-            eventCode = stoi(line.substr(line.find("=") + 1));
-        }
-        if (line.find("ARRAY_FOREST") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) arrayForest.push_back(parsePos(s));
-        }
-        if (line.find("ARRAY_RIVER") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) arrayRiver.push_back(parsePos(s));
-        }
-        if (line.find("ARRAY_FORTIFICATION") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) arrayFortification.push_back(parsePos(s));
-        }
-        if (line.find("ARRAY_URBAN") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) arrayUrban.push_back(parsePos(s));
-        }
-        if (line.find("ARRAY_SPECIAL_ZONE") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) arraySpecialZone.push_back(parsePos(s));
-        }
-        if (line.find("UNIT_LIST") != string::npos) {
-            size_t start = line.find('['), end = line.find(']');
-            vector<string> lst = splitListStr(line.substr(start + 1, end - start - 1));
-            for (auto &s : lst) {
-                // VD: TANK(5,2,(1,2),0)
-                size_t nameEnd = s.find('(');
-                string name = s.substr(0, nameEnd);
-                vector<string> fields;
-                string content = s.substr(nameEnd + 1, s.length() - nameEnd - 2); // bỏ ()
-                stringstream ss(content);
-                string field;
-                while (getline(ss, field, ',')) fields.push_back(field);
-                int q = stoi(fields[0]), w = stoi(fields[1]);
-                Position pos(fields[2]);
-                int army = stoi(fields[3]);
-                if (name == "TANK") {
-                    Vehicle *unit = new Vehicle(q, w, pos, TANK);
-                    if (army == 0) liber.push_back(unit);
-                    else arvn.push_back(unit);
-                } else if (name == "REGULARINFANTRY") {
-                    Infantry *unit = new Infantry(q, w, pos, REGULARINFANTRY);
-                    if (army == 0) liber.push_back(unit);
-                    else arvn.push_back(unit);
-                }
-                // Thêm các loại khác nếu cần (nếu đề yêu cầu)
-            }
-        }
+    const char *begin, *end;
+    int lineNo = 0;
+    while (reader.next(begin, end)) parseLine(begin, end, ++lineNo, liber, arvn);
+    linkTerrain();
+    adoptUnits(liber, arvn);
+}
+Unit *Configuration::makeUnit(UnitKind kind, int type, int quantity, int weight, const Position &pos) {
+    if (kind == VEHICLE_UNIT)
+        return pool ? pool->newVehicle(quantity, weight, pos, (VehicleType)type)
+                    : new Vehicle(quantity, weight, pos, (VehicleType)type);
+    return pool ? pool->newInfantry(quantity, weight, pos, (InfantryType)type)
+                : new Infantry(quantity, weight, pos, (InfantryType)type);
+}
+void Configuration::linkTerrain() {
+    vector<Position*> *arrays[SPECIAL_ZONE + 1] = { nullptr, &arrayForest, &arrayRiver,
+                                                    &arrayFortification, &arrayUrban, &arraySpecialZone };
+    for (int t = FOREST; t <= SPECIAL_ZONE; ++t) {
+        arrays[t]->reserve(terrainStore[t].size());
+        for (size_t i = 0; i < terrainStore[t].size(); ++i) arrays[t]->push_back(&terrainStore[t][i]);
     }
+}
+void Configuration::adoptUnits(const vector<Unit*> &liber, const vector<Unit*> &arvn) {
     liberationUnitsCount = liber.size();
     ARVNUnitsCount = arvn.size();
     liberationUnits = liberationUnitsCount ? new Unit*[liberationUnitsCount] : nullptr;
     ARVNUnits = ARVNUnitsCount ? new Unit*[ARVNUnitsCount] : nullptr;
     for (int i = 0; i < liberationUnitsCount; ++i) liberationUnits[i] = liber[i];
     for (int i = 0; i < ARVNUnitsCount; ++i) ARVNUnits[i] = arvn[i];
-    fin.close();
+}
+// Each line is KEY=VALUE; the key is matched once and the value is scanned
+// in place.
+static string diagnostic(int lineNo, int column, const string &message) {
+    ostringstream oss;
+    oss << "line " << lineNo << ", column " << column << ": " << message;
+    return oss.str();
+}
+void Configuration::parseLine(const char *begin, const char *end, int lineNo, vector<Unit*> &liber, vector<Unit*> &arvn) {
+    ConfigCursor cur = { begin, end };
+    cur.skipSpace();
+    const char *key = cur.p;
+    while (cur.p < end && *cur.p != '=' && *cur.p != ' ' && *cur.p != '\t') ++cur.p;
+    size_t keyLen = cur.p - key;
+    if (!cur.accept('=')) {
+        cur.skipSpace();
+        if (keyLen > 0 || cur.p != end)
+            diagnostics.push_back(diagnostic(lineNo, key - begin + 1, "expected KEY=VALUE"));
+        return;
+    }
+
+    int value;
+    TerrainType terrainType = ROAD;
+    string keyName(key, keyLen);
+    bool scalar = keyIs(key, keyLen, "NUM_ROWS") || keyIs(key, keyLen, "NUM_COLS") ||
+                  keyIs(key, keyLen, "EVENT_CODE");
+    if (scalar) {
+        cur.skipSpace();
+        const char *at = cur.p;
+        if (!cur.parseInt(value)) {
+            diagnostics.push_back(diagnostic(lineNo, at - begin + 1, "invalid integer for " + keyName));
+            return;
+        }
+        cur.skipSpace();
+        if (cur.p != end) {
+            diagnostics.push_back(diagnostic(lineNo, cur.p - begin + 1, "unexpected characters after " + keyName + " value"));
+            return;
+        }
+        if (keyName == "NUM_ROWS") num_rows = value;
+        else if (keyName == "NUM_COLS") num_cols = value;
+        else eventCode = value < 0 ? 0 : value % 100;
+    } else if (keyIs(key, keyLen, "ARRAY_FOREST")) terrainType = FOREST;
+    else if (keyIs(key, keyLen, "ARRAY_RIVER")) terrainType = RIVER;
+    else if (keyIs(key, keyLen, "ARRAY_FORTIFICATION")) terrainType = FORTIFICATION;
+    else if (keyIs(key, keyLen, "ARRAY_URBAN")) terrainType = URBAN;
+    else if (keyIs(key, keyLen, "ARRAY_SPECIAL_ZONE")) terrainType = SPECIAL_ZONE;
+    else if (keyIs(key, keyLen, "UNIT_LIST")) {
+        // VD: TANK(5,2,(1,2),0)
+        if (!cur.accept('[')) {
+            diagnostics.push_back(diagnostic(lineNo, cur.p - begin + 1, "expected '[' after UNIT_LIST="));
+            return;
+        }
+        // A bad entry is reported and skipped; the entries after it still load.
+        while (!cur.accept(']')) {
+            if (cur.p == end) {
+                diagnostics.push_back(diagnostic(lineNo, cur.p - begin + 1, "unterminated UNIT_LIST"));
+                return;
+            }
+            const char *name = cur.p;
+            while (cur.p < end && *cur.p != '(' && *cur.p != ' ' && *cur.p != ',' && *cur.p != ']') ++cur.p;
+            size_t nameLen = cur.p - name;
+            int q, w, r, c, army;
+            UnitKind kind;
+            int type;
+            if (!(cur.accept('(') && cur.parseInt(q) && cur.accept(',') && cur.parseInt(w) &&
+                  cur.accept(',') && cur.parsePosition(r, c) && cur.accept(',') &&
+                  cur.parseInt(army) && cur.accept(')'))) {
+                diagnostics.push_back(diagnostic(lineNo, name - begin + 1,
+                                                 "malformed unit entry '" + string(name, nameLen) + "'"));
+                cur.p = name;
+                cur.skipEntry();
+            } else if (!UnitNameTable::lookup(name, nameLen, kind, type)) {
+                diagnostics.push_back(diagnostic(lineNo, name - begin + 1,
+                                                 "unknown unit name '" + string(name, nameLen) + "'"));
+            } else if (army != 0 && army != 1) {
+                diagnostics.push_back(diagnostic(lineNo, name - begin + 1,
+                                                 "army of '" + string(name, nameLen) + "' must be 0 or 1"));
+            } else {
+                (army == 0 ? liber : arvn).push_back(makeUnit(kind, type, q, w, Position(r, c)));
+            }
+            cur.accept(',');
+        }
+    } else {
+        diagnostics.push_back(diagnostic(lineNo, key - begin + 1, "unknown key '" + keyName + "'"));
+    }
+    if (terrainType == ROAD) return;
+
+    if (!cur.accept('[')) {
+        diagnostics.push_back(diagnostic(lineNo, cur.p - begin + 1, "expected '[' after " + keyName + "="));
+        return;
+    }
+    int r, c;
+    while (!cur.accept(']')) {
+        if (cur.p == end) {
+            diagnostics.push_back(diagnostic(lineNo, cur.p - begin + 1, "unterminated " + keyName));
+            return;
+        }
+        const char *at = cur.p;
+        if (cur.parsePosition(r, c)) {
+            terrainStore[terrainType].push_back(Position(r, c));
+        } else {
+            diagnostics.push_back(diagnostic(lineNo, at - begin + 1, "malformed position in " + keyName));
+            cur.p = at;
+            cur.skipEntry();
+        }
+        cur.accept(',');
+    }
 }
 Configuration::~Configuration() {
-    for (auto p : arrayForest) delete p;
-    for (auto p : arrayRiver) delete p;
-    for (auto p : arrayFortification) delete p;
-    for (auto p : arrayUrban) delete p;
-    for (auto p : arraySpecialZone) delete p;
-    if (liberationUnits) {
+    if (!pool) {
         for (int i = 0; i < liberationUnitsCount; ++i) delete liberationUnits[i];
-        delete[] liberationUnits;
-    }
-    if (ARVNUnits) {
         for (int i = 0; i < ARVNUnitsCount; ++i) delete ARVNUnits[i];
-        delete[] ARVNUnits;
     }
+    delete[] liberationUnits;
+    delete[] ARVNUnits;
 }
 string Configuration::str() const {
-    ostringstream oss;
-    oss << "Configuration[";
-    oss << "num_rows=" << num_rows << ",num_cols=" << num_cols << ",";
-
-    auto formatPosList = [](const vector<Position*>& vec) -> string {
-        ostringstream s;
-        s << "[";
-        for (size_t i = 0; i < vec.size(); ++i) {
-            if (i > 0) s << ",";
-            s << vec[i]->str();
-        }
-        s << "]";
-        return s.str();
-    };
-
-    oss << "arrayForest=" << formatPosList(arrayForest) << ",";
-    oss << "arrayRiver=" << formatPosList(arrayRiver) << ",";
-    oss << "arrayFortification=" << formatPosList(arrayFortification) << ",";
-    oss << "arrayUrban=" << formatPosList(arrayUrban) << ",";
-    oss << "arraySpecialZone=" << formatPosList(arraySpecialZone) << ",";
-
-    // Liberation Units
-    oss << "liberationUnits=[";
-    for (int i = 0; i < liberationUnitsCount; ++i) {
-        if (i > 0) oss << ",";
-        oss << liberationUnits[i]->str();
+    string out;
+    appendTo(out);
+    return out;
+}
+static void appendPositions(string &out, const char *label, const vector<Position*> &positions) {
+    out += label;
+    out += "=[";
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (i > 0) out += ',';
+        positions[i]->appendTo(out);
     }
-    oss << "],";
-
-    // ARVN Units
-    oss << "ARVNUnits=[";
-    for (int i = 0; i < ARVNUnitsCount; ++i) {
-        if (i > 0) oss << ",";
-        oss << ARVNUnits[i]->str();
+    out += "],";
+}
+static void appendUnits(string &out, const char *label, Unit **units, int count) {
+    out += label;
+    out += "=[";
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) out += ',';
+        units[i]->appendTo(out);
     }
-    oss << "],";
-
-    oss << "eventCode=" << eventCode << "]";
-    return oss.str();
+    out += "],";
+}
+void Configuration::appendTo(string &out) const {
+    out += "Configuration[num_rows=";
+    appendInt(out, num_rows);
+    out += ",num_cols=";
+    appendInt(out, num_cols);
+    out += ',';
+    appendPositions(out, "arrayForest", arrayForest);
+    appendPositions(out, "arrayRiver", arrayRiver);
+    appendPositions(out, "arrayFortification", arrayFortification);
+    appendPositions(out, "arrayUrban", arrayUrban);
+    appendPositions(out, "arraySpecialZone", arraySpecialZone);
+    appendUnits(out, "liberationUnits", liberationUnits, liberationUnitsCount);
+    appendUnits(out, "ARVNUnits", ARVNUnits, ARVNUnitsCount);
+    out += "eventCode=";
+    appendInt(out, eventCode);
+    out += ']';
 }
 
 int Configuration::getNumRows() const { return num_rows; }
@@ -409,18 +1740,216 @@ int Configuration::getLiberationUnitsCount() const { return liberationUnitsCount
 Unit** Configuration::getARVNUnits() const { return ARVNUnits; }
 int Configuration::getARVNUnitsCount() const { return ARVNUnitsCount; }
 int Configuration::getEventCode() const { return eventCode; }
+const vector<string>& Configuration::getDiagnostics() const { return diagnostics; }
+
+// ====================== CampaignSteps ==========================
+CampaignState::CampaignState(Configuration *config, UnitPool *pool, int eventCode)
+    : pool(pool), config(config), eventCode(eventCode), battleField(nullptr), liberationArmy(nullptr),
+      arvn(nullptr), terrainApplied(false), event(LIBERATION_OFFENSIVE), planned(0), fought(0), weakUnitsPending(false) {}
+
+void CampaignSteps::buildBattleField(CampaignState &state) {
+    if (state.battleField) return;
+    const Configuration *config = state.config;
+    state.battleField = new BattleField(config->getNumRows(), config->getNumCols(), config->getArrayForest(),
+                                        config->getArrayRiver(), config->getArrayFortification(),
+                                        config->getArrayUrban(), config->getArraySpecialZone());
+}
+void CampaignSteps::buildArmies(CampaignState &state) {
+    const Configuration *config = state.config;
+    if (!state.liberationArmy)
+        state.liberationArmy = new LiberationArmy(config->getLiberationUnits(), config->getLiberationUnitsCount(),
+                                                  "LiberationArmy", state.battleField, state.pool);
+    if (!state.arvn)
+        state.arvn = new ARVN(config->getARVNUnits(), config->getARVNUnitsCount(), "ARVN",
+                              state.battleField, state.pool);
+}
+void CampaignSteps::applyTerrain(CampaignState &state) {
+    if (state.terrainApplied) return;
+    HCM_STAGE(TERRAIN);
+    state.battleField->applyTerrainEffects(state.liberationArmy, state.arvn);
+    state.terrainApplied = true;
+}
+void CampaignSteps::dispatch(CampaignState &state) {
+    Army *liberation = state.liberationArmy, *arvn = state.arvn;
+    state.event = state.eventCode < 75 ? LIBERATION_OFFENSIVE : ARVN_OFFENSIVE;
+    state.planned = state.fought = 0;
+    if (state.event == ARVN_OFFENSIVE) {
+        state.plan[state.planned].attacker = arvn;
+        state.plan[state.planned++].defender = liberation;
+    }
+    state.plan[state.planned].attacker = liberation;
+    state.plan[state.planned++].defender = arvn;
+}
+static void fight(Army *army, Army *enemy, bool defense) {
+#ifdef HCM_INSTRUMENT
+    StageTimer timer(army->isLiberationArmy() ? CampaignStats::LIBERATION_FIGHT : CampaignStats::ARVN_FIGHT);
+#endif
+    army->fight(enemy, defense);
+}
+void CampaignSteps::battle(CampaignState &state) {
+    if (state.fought >= state.planned) return;
+    const Engagement &engagement = state.plan[state.fought++];
+    fight(engagement.attacker, engagement.defender, false);
+    fight(engagement.defender, engagement.attacker, true);
+    state.weakUnitsPending = true;
+}
+void CampaignSteps::removeWeakUnits(CampaignState &state) {
+    if (!state.weakUnitsPending) return;
+    state.liberationArmy->getUnitList()->removeIfAttackScoreLE5();
+    state.arvn->getUnitList()->removeIfAttackScoreLE5();
+    state.weakUnitsPending = false;
+}
+void CampaignSteps::result(CampaignState &state) {
+    ostringstream oss;
+    oss << "LIBERATIONARMY[LF=" << state.liberationArmy->getLF() << ",EXP=" << state.liberationArmy->getEXP()
+        << "]-ARVN[LF=" << state.arvn->getLF() << ",EXP=" << state.arvn->getEXP() << "]";
+    state.result = oss.str();
+}
+
+// ====================== CampaignPipeline ==========================
+CampaignPipeline CampaignPipeline::deployment() {
+    CampaignPipeline pipeline;
+    pipeline.add("buildBattleField", CampaignSteps::buildBattleField)
+            .add("buildArmies", CampaignSteps::buildArmies);
+    return pipeline;
+}
+CampaignPipeline CampaignPipeline::resolution() {
+    CampaignPipeline pipeline;
+    pipeline.add("dispatch", CampaignSteps::dispatch);
+    for (int i = 0; i < CampaignState::MAX_ENGAGEMENTS; ++i)
+        pipeline.add("battle", CampaignSteps::battle).add("removeWeakUnits", CampaignSteps::removeWeakUnits);
+    return pipeline;
+}
+CampaignPipeline CampaignPipeline::standard() {
+    CampaignPipeline pipeline;
+    pipeline.add("applyTerrain", CampaignSteps::applyTerrain)
+            .add(resolution())
+            .add("result", CampaignSteps::result);
+    return pipeline;
+}
+CampaignPipeline &CampaignPipeline::add(const char *name, CampaignStepFunction apply) {
+    CampaignStep step = { name, apply };
+    steps.push_back(step);
+    return *this;
+}
+CampaignPipeline &CampaignPipeline::add(const CampaignPipeline &other) {
+    steps.insert(steps.end(), other.steps.begin(), other.steps.end());
+    return *this;
+}
+int CampaignPipeline::remove(const string &name) {
+    size_t before = steps.size();
+    steps.erase(remove_if(steps.begin(), steps.end(),
+                          [&name](const CampaignStep &step) { return name == step.name; }),
+                steps.end());
+    return before - steps.size();
+}
+int CampaignPipeline::size() const { return steps.size(); }
+const CampaignStep &CampaignPipeline::operator[](int idx) const { return steps[idx]; }
+void CampaignPipeline::run(CampaignState &state) const {
+    for (size_t i = 0; i < steps.size(); ++i) steps[i].apply(state);
+}
 
 // ====================== HCMCampaign ==========================
+// Configuration and both armies allocate their units from the campaign's
+// pool: the armies keep pooled copies of the configured units, and the pool
+// frees all of them after everything that points at them is gone.
 HCMCampaign::HCMCampaign(const string &config_file_path)
-    : config(nullptr), battleField(nullptr), liberationArmy(nullptr), arvn(nullptr) {
-    config = new Configuration(config_file_path);
-    // Optional: khởi tạo luôn army và battlefield ở đây nếu muốn
+    : unitPool(new UnitPool()), config(nullptr), battleField(nullptr), liberationArmy(nullptr), arvn(nullptr),
+      terrainApplied(false) {
+    HCM_STATS_SCOPE(stats);
+    config = new Configuration(config_file_path, unitPool);
+    reportDiagnostics(config_file_path);
+    deploy();
+}
+HCMCampaign::HCMCampaign(istream &config_text, const string &source)
+    : unitPool(new UnitPool()), config(nullptr), battleField(nullptr), liberationArmy(nullptr), arvn(nullptr),
+      terrainApplied(false) {
+    HCM_STATS_SCOPE(stats);
+    config = new Configuration(config_text, unitPool);
+    reportDiagnostics(source);
+    deploy();
+}
+HCMCampaign::HCMCampaign(Configuration *config)
+    : unitPool(new UnitPool()), config(config), battleField(nullptr), liberationArmy(nullptr), arvn(nullptr),
+      terrainApplied(false) {
+    HCM_STATS_SCOPE(stats);
+    deploy();
+}
+// One write per line, so campaigns loading on several threads do not
+// interleave inside a message.
+void HCMCampaign::reportDiagnostics(const string &source) const {
+    const vector<string> &diagnostics = config->getDiagnostics();
+    for (size_t i = 0; i < diagnostics.size(); ++i) cerr << source + ": " + diagnostics[i] + "\n";
+}
+void HCMCampaign::deploy() {
+    CampaignState state = currentState(config->getEventCode());
+    CampaignPipeline::deployment().run(state);
+    adoptState(state);
 }
 HCMCampaign::~HCMCampaign() {
-    delete config;
-    delete battleField;
     delete liberationArmy;
     delete arvn;
+    delete battleField;
+    delete config;
+    delete unitPool;
+}
+// The armies, battlefield and terrain flag stay members, so a step's output
+// is copied back into the campaign once the pipeline finishes.
+CampaignState HCMCampaign::currentState(int eventCode) const {
+    CampaignState state(config, unitPool, eventCode);
+    state.battleField = battleField;
+    state.liberationArmy = liberationArmy;
+    state.arvn = arvn;
+    state.terrainApplied = terrainApplied;
+    return state;
+}
+void HCMCampaign::adoptState(const CampaignState &state) {
+    battleField = state.battleField;
+    liberationArmy = state.liberationArmy;
+    arvn = state.arvn;
+    terrainApplied = state.terrainApplied;
+    lastResult = state.result;
+}
+void HCMCampaign::run() {
+    run(CampaignPipeline::standard());
+}
+void HCMCampaign::run(const CampaignPipeline &pipeline) {
+    HCM_STATS_SCOPE(stats);
+    CampaignState state = currentState(config->getEventCode());
+    pipeline.run(state);
+    adoptState(state);
+}
+void HCMCampaign::applyTerrain() {
+    run(CampaignPipeline().add("applyTerrain", CampaignSteps::applyTerrain));
+}
+void HCMCampaign::resolve(int eventCode) {
+    HCM_STATS_SCOPE(stats);
+    CampaignState state = currentState(eventCode);
+    CampaignPipeline::resolution().run(state);
+    adoptState(state);
+}
+const string &HCMCampaign::getLastResult() const { return lastResult; }
+// Terrain is static and the unit index is rebuilt by every terrain pass, so
+// the armies are all there is to copy.
+void HCMCampaign::saveTo(CampaignSnapshot &snapshot) const {
+    liberationArmy->saveTo(snapshot.liberationArmy);
+    arvn->saveTo(snapshot.arvn);
+    snapshot.terrainApplied = terrainApplied;
+}
+void HCMCampaign::restoreFrom(const CampaignSnapshot &snapshot) {
+    HCM_STATS_SCOPE(stats);
+    liberationArmy->restoreFrom(snapshot.liberationArmy);
+    arvn->restoreFrom(snapshot.arvn);
+    terrainApplied = snapshot.terrainApplied;
+}
+string HCMCampaign::printResult() {
+    CampaignState state = currentState(config->getEventCode());
+    CampaignSteps::result(state);
+    return state.result;
 }
-void HCMCampaign::run() {}
-string HCMCampaign::printResult() { return ""; }
+const LiberationArmy *HCMCampaign::getLiberationArmy() const { return liberationArmy; }
+const ARVN *HCMCampaign::getARVN() const { return arvn; }
+const vector<string> &HCMCampaign::getDiagnostics() const { return config->getDiagnostics(); }
+#ifdef HCM_INSTRUMENT
+const CampaignStats &HCMCampaign::getStats() const { return stats; }
+#endif
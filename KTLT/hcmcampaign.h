@@ -3,8 +3,16 @@
 
 #include "main.h"
 
+class UnitList;
+class Army;
+class ArmyScoreView;
+class Vehicle;
+class Infantry;
+
 enum VehicleType { TRUCK, MORTAR, ANTIAIRCRAFT, ARMOREDCAR, APC, ARTILLERY, TANK };
 enum InfantryType { SNIPER, ANTIAIRCRAFTSQUAD, MORTARSQUAD, ENGINEER, SPECIALFORCES, REGULARINFANTRY };
+enum UnitKind { UNKNOWN_UNIT, VEHICLE_UNIT, INFANTRY_UNIT };
+enum TerrainType { ROAD, FOREST, RIVER, FORTIFICATION, URBAN, SPECIAL_ZONE };
 
 class Position {
 private:
@@ -17,18 +25,82 @@ public:
     void setRow(int r);
     void setCol(int c);
     string str() const;
+    // Every str() in this file is a wrapper over an appendTo that renders
+    // the same text straight into the caller's buffer.
+    void appendTo(string &out) const;
+};
+
+// Pure attack score formulas, shared by the units and by any code that needs
+// a score without touching a Unit.
+class ScoreEngine {
+public:
+    static int vehicleScore(int vehicleType, int quantity, int weight);
+    static int infantryScore(int infantryType, int quantity, int weight);
+    static int personalNumber(int score);
+    static int adjustedQuantity(int infantryType, int quantity, int weight);
+    // Sum of distinct powers of 3, 5 or 7, i.e. only 0/1 digits in one of
+    // those bases. O(1) table lookup over the reachable LF + EXP range.
+    static bool isSpecialNumber(int n);
+    // UnitList capacity for an army of total strength LF + EXP.
+    static int listCapacity(int strength);
+};
+
+// Exact search for the subset of scores with the smallest sum strictly
+// greater than a threshold. Uses a reachability DP over [0, threshold] and
+// falls back to meet-in-the-middle when that table would be too large.
+// Both skip scores <= 0, so with negative inputs they can return a larger sum
+// than the true minimum. Callers pass effective scores, which are never
+// negative, so no subset is lost.
+class CombinationSelector {
+public:
+    static bool selectMinAbove(const vector<int> &scores, int threshold, vector<int> &chosen);
+private:
+    static bool selectByDP(const vector<int> &scores, int threshold, vector<int> &chosen);
+    static bool selectByMeetInMiddle(const vector<int> &scores, int threshold, vector<int> &chosen);
 };
 
 class Unit {
 protected:
     int quantity, weight;
     Position pos;
+    UnitKind kind;
+    // quantity as last set, before any score-driven adjustment
+    int baseQuantity;
+    // score cached by getAttackScore until quantity or weight changes
+    int score;
+    bool scoreValid;
+    // Terrain adjustment to the score, fixed when terrain is applied and
+    // carried with the unit wherever it goes. A neutralized unit (special
+    // zone) scores 0 whatever its other adjustments.
+    int terrainModifier;
+    bool neutralized;
+    Unit(int quantity, int weight, Position pos, UnitKind kind);
+    Unit(const Unit &other);
+private:
+    // list holding this unit; told about every score change
+    UnitList *owner;
+    void invalidateScore();
+    int effectiveOf(int attackScore) const;
+    friend class UnitList;
+    friend class ArmyScoreView;
 public:
     Unit(int quantity, int weight, Position pos);
     virtual ~Unit();
     virtual int getAttackScore() = 0;
+    virtual int evaluateAttackScore() const = 0;
+    // Attack score after terrain, never below 0: what LF/EXP and the battle
+    // rules count.
+    int getEffectiveScore();
+    int evaluateEffectiveScore() const;
+    int getTerrainModifier() const;
+    bool isNeutralized() const;
+    void addTerrainModifier(int delta);
+    void neutralize();
     Position getCurrentPosition() const;
+    UnitKind getKind() const;
     virtual string str() const = 0;
+    virtual void appendTo(string &out) const = 0;
+    virtual Unit* clone() const = 0;
     int getQuantity() const;
     int getWeight() const;
     void setQuantity(int q);
@@ -41,7 +113,10 @@ private:
 public:
     Vehicle(int quantity, int weight, const Position pos, VehicleType vehicleType);
     int getAttackScore();
+    int evaluateAttackScore() const;
     string str() const;
+    void appendTo(string &out) const;
+    Unit* clone() const;
     VehicleType getVehicleType() const;
 };
 
@@ -51,79 +126,438 @@ private:
 public:
     Infantry(int quantity, int weight, const Position pos, InfantryType infantryType);
     int getAttackScore();
+    int evaluateAttackScore() const;
     string str() const;
+    void appendTo(string &out) const;
+    Unit* clone() const;
     InfantryType getInfantryType() const;
 };
 
+// Campaign-scoped storage for units. Vehicles and Infantry are carved out of
+// fixed-size blocks, one chain per type, and are all destroyed together with
+// the pool; nothing allocated here may be deleted individually. Units handed
+// back through release are recycled by later allocations.
+class UnitPool {
+private:
+    static const int BLOCK_UNITS = 256;
+    vector<Vehicle*> vehicleBlocks;
+    vector<Infantry*> infantryBlocks;
+    int vehiclesInLastBlock, infantryInLastBlock;
+    vector<Vehicle*> freeVehicles;
+    vector<Infantry*> freeInfantry;
+    template <class T> void *allocate(vector<T*> &blocks, int &usedInLast, vector<T*> &freeList);
+    template <class T> void destroy(vector<T*> &blocks, int usedInLast);
+public:
+    UnitPool();
+    ~UnitPool();
+    UnitPool(const UnitPool &) = delete;
+    UnitPool &operator=(const UnitPool &) = delete;
+    Vehicle *newVehicle(int quantity, int weight, const Position &pos, VehicleType vehicleType);
+    Infantry *newInfantry(int quantity, int weight, const Position &pos, InfantryType infantryType);
+    Unit *copy(const Unit *unit);
+    void release(Unit *unit);
+    // Units currently handed out.
+    int getUnitCount() const;
+};
+
+// Plain copy of one unit, enough to rebuild it without the configuration.
+struct UnitRecord {
+    UnitKind kind;
+    int type;
+    int quantity, baseQuantity, weight;
+    int row, col;
+    int score;
+    bool scoreValid;
+    int terrainModifier;
+    bool neutralized;
+};
+
+// Read-only window over a list's units in display order: a pointer range
+// into the list's contiguous array. Valid until the list is next modified.
+class UnitSpan {
+private:
+    Unit *const *first;
+    int count;
+public:
+    typedef Unit *const *iterator;
+    UnitSpan(Unit *const *first, int count);
+    iterator begin() const;
+    iterator end() const;
+    int size() const;
+    bool empty() const;
+    Unit *operator[](int idx) const;
+};
+
 class UnitList {
+private:
+    static const int NUM_VEHICLE_TYPES = 7;
+    static const int NUM_INFANTRY_TYPES = 6;
+    int capacity;
+    // Units in display order, kept contiguous: infantry fill the first half
+    // from its end towards the front, vehicles fill the second half in order.
+    Unit *units[NUM_INFANTRY_TYPES + NUM_VEHICLE_TYPES];
 public:
-    struct Node {
-        Unit* data;
-        Node* next;
-        Node(Unit* u) : data(u), next(nullptr) {}
+    // A list never holds more than one unit per type, so its whole state
+    // fits in a fixed-size value.
+    struct Snapshot {
+        int capacity;
+        int count_vehicle, count_infantry;
+        UnitRecord units[NUM_INFANTRY_TYPES + NUM_VEHICLE_TYPES];
     };
 private:
-    int capacity;
-    Node* head;
+    Unit *vehicleSlot[NUM_VEHICLE_TYPES];
+    Unit *infantrySlot[NUM_INFANTRY_TYPES];
     int count_vehicle, count_infantry;
+    Army *army;
+    // owns the units when set; otherwise they are heap copies freed here
+    UnitPool *pool;
+    void unitScoreChanged(Unit *unit, int oldScore);
+    bool detach(Unit *unit);
+    void releaseRemoved(Unit **removed, int count);
+    friend class Unit;
+    friend class Army;
 public:
-    UnitList(int capacity);
+    // Capacity bounds the number of distinct units; merging into a type
+    // already present always succeeds.
+    UnitList(int capacity, UnitPool *pool = nullptr);
+    // Capacity for an army given these units: ScoreEngine::listCapacity of
+    // the capped LF + EXP the list would hold once they were all inserted.
+    static int capacityFor(Unit *const *units, int size);
     ~UnitList();
+    // Units are owned through raw pointers; use saveTo/restoreFrom to copy.
+    UnitList(const UnitList &) = delete;
+    UnitList &operator=(const UnitList &) = delete;
+    void saveTo(Snapshot &snapshot) const;
+    // Reuses the unit objects already in the list where the type matches.
+    void restoreFrom(const Snapshot &snapshot);
     bool insert(Unit *unit);
+    int getCapacity() const;
+    // Units already in the list are kept even if they exceed the new capacity.
+    void setCapacity(int capacity);
     bool isContain(VehicleType vehicleType);
     bool isContain(InfantryType infantryType);
     string str() const;
+    void appendTo(string &out) const;
     int getCountVehicle() const;
     int getCountInfantry() const;
     int getTotalCount() const;
     Unit* getUnitAt(int idx) const;
+    // Units are contiguous, so iteration is a pointer walk. Inserting or
+    // removing invalidates iterators and spans.
+    typedef UnitSpan::iterator const_iterator;
+    const_iterator begin() const;
+    const_iterator end() const;
+    UnitSpan view() const;
+    bool remove(Unit *unit);
+    // Drops every unit the predicate accepts in one pass over the list,
+    // keeping the survivors' order; the army's LF/EXP are updated once.
+    // Returns how many units were removed.
+    template <class Predicate> int removeIf(Predicate pred);
     void removeIfAttackScoreLE5();
-    friend class Army;
+};
+
+template <class Predicate> int UnitList::removeIf(Predicate pred) {
+    Unit *removed[NUM_INFANTRY_TYPES + NUM_VEHICLE_TYPES];
+    int count = 0;
+    // Infantry end at NUM_INFANTRY_TYPES - 1, so survivors are packed
+    // towards the back; vehicles start at NUM_INFANTRY_TYPES and are packed
+    // towards the front.
+    int write = NUM_INFANTRY_TYPES;
+    for (int read = NUM_INFANTRY_TYPES - 1; read >= NUM_INFANTRY_TYPES - count_infantry; --read) {
+        if (pred(units[read])) removed[count++] = units[read];
+        else units[--write] = units[read];
+    }
+    count_infantry = NUM_INFANTRY_TYPES - write;
+    write = NUM_INFANTRY_TYPES;
+    for (int read = NUM_INFANTRY_TYPES; read < NUM_INFANTRY_TYPES + count_vehicle; ++read) {
+        if (pred(units[read])) removed[count++] = units[read];
+        else units[write++] = units[read];
+    }
+    count_vehicle = write - NUM_INFANTRY_TYPES;
+    if (count) releaseRemoved(removed, count);
+    return count;
+}
+
+// Structure-of-arrays copy of units, one column per field, for scoring many
+// units at once. computeScores gives every unit the score getEffectiveScore
+// would (infantry from baseQuantity, with the personal-number adjustment,
+// then the terrain modifier) and the uncapped totals updateLF_EXP sums, four
+// lanes at a time when the compiler has GCC vector extensions.
+class ArmyScoreView {
+private:
+    vector<int> vehicleType, vehicleQuantity, vehicleWeight, vehicleModifier, vehicleNeutralized, vehicleScore;
+    vector<int> infantryType, infantryQuantity, infantryWeight, infantryBonus, infantryModifier, infantryNeutralized,
+                infantryScore;
+    // Set when a value is outside the range the lane arithmetic is exact
+    // for; computeScores then takes the scalar path.
+    bool needsScalar;
+public:
+    ArmyScoreView();
+    void clear();
+    void add(const Unit *unit);
+    void addAll(const UnitList *list);
+    int getVehicleCount() const;
+    int getInfantryCount() const;
+    void computeScores(int &LF, int &EXP);
+    // Same results through ScoreEngine, one unit at a time.
+    void computeScoresScalar(int &LF, int &EXP);
+    const vector<int>& getVehicleScores() const;
+    const vector<int>& getInfantryScores() const;
+};
+
+// Euclidean distance for a squared cell distance. Terrain radii never exceed
+// MAX_RADIUS, so every distance a terrain effect needs comes from a
+// compile-time table of correctly rounded square roots, equal to what sqrt()
+// returns.
+class DistanceTable {
+public:
+    static const int MAX_RADIUS = 5;
+    // sqrt(dist2), from the table up to MAX_RADIUS^2.
+    static double distance(long long dist2);
+};
+
+// A terrain cell. Every effect is a change to one unit's terrain modifier,
+// computed from the unit's attack score before terrain, so the order elements
+// are applied in (getEffect one at a time, or BattleField::applyTerrainEffects
+// for all of them) does not matter. The owning army's LF/EXP follow each
+// change as it is made.
+class TerrainElement {
+protected:
+    Position pos;
+    void applyEffect(Army *army) const;
+public:
+    TerrainElement();
+    TerrainElement(const Position &pos);
+    virtual ~TerrainElement();
+    virtual void getEffect(Army *army) = 0;
+    Position getPosition() const;
+    // Radius (in cells) within which units of this army are affected.
+    virtual int effectRadius(const Army *army) const = 0;
+    // Change to the modifier of one unit at squared distance dist2.
+    virtual int unitEffect(const Army *army, const Unit *unit, long long dist2) const = 0;
+    // True if units in range are reduced to 0 instead.
+    virtual bool neutralizes() const;
+    // Applies the effect to one unit in range.
+    void affect(const Army *army, Unit *unit, long long dist2) const;
+};
+
+class Road : public TerrainElement {
+public:
+    Road(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+};
+
+class Mountain : public TerrainElement {
+public:
+    Mountain(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+};
+
+class River : public TerrainElement {
+public:
+    River(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+};
+
+class Urban : public TerrainElement {
+public:
+    Urban(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+};
+
+class Fortification : public TerrainElement {
+public:
+    Fortification(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+};
+
+class SpecialZone : public TerrainElement {
+public:
+    SpecialZone(const Position &pos);
+    void getEffect(Army *army);
+    int effectRadius(const Army *army) const;
+    int unitEffect(const Army *army, const Unit *unit, long long dist2) const;
+    bool neutralizes() const;
+};
+
+// Unit positions grouped into square buckets and kept sorted by bucket, so
+// memory is O(units) whatever the map size and a radius query only visits
+// the buckets overlapping the query square.
+class UnitSpatialIndex {
+private:
+    static const int BUCKET_SIZE = 8;
+    struct Entry {
+        long long bucket;
+        int r, c;
+        const Army *army;
+        Unit *unit;
+        bool operator<(const Entry &other) const { return bucket < other.bucket; }
+    };
+    int bucketRows, bucketCols;
+    vector<Entry> entries;
+    int bucketRow(int r) const;
+    int bucketCol(int c) const;
+public:
+    UnitSpatialIndex(int n_rows, int n_cols);
+    void clear();
+    void add(const Army *army);
+    void build();
+    void query(const Army *army, int r, int c, int radius, vector<Unit*> &out) const;
+    int size() const;
+};
+
+// Terrain type of every on-map cell, ROAD where nothing was placed. Dense
+// maps use three bit-planes (3 bits per cell, so a 10^4 x 10^4 map needs
+// 37.5 MB); when the terrain cells are few enough that an open-addressing
+// table of them is smaller, only those cells are stored. A cell listed under
+// several types keeps the last one in TerrainType order.
+class TerrainGrid {
+private:
+    static const int PLANES = 3;
+    int n_rows, n_cols;
+    bool sparse;
+    vector<unsigned long long> planes[PLANES];
+    // sparse: linear probing over cell = r * n_cols + c, -1 marks a free slot
+    vector<long long> keys;
+    vector<unsigned char> types;
+    long long cellOf(int r, int c) const;
+    size_t slotOf(long long cell) const;
+    void set(long long cell, TerrainType type);
+    int countDense(long long from, long long to, TerrainType type) const;
+public:
+    TerrainGrid();
+    // terrain is indexed by TerrainType; ROAD entries are ignored.
+    void build(int n_rows, int n_cols, const vector<Position> *terrain);
+    bool isSparse() const;
+    // ROAD for off-map cells as well.
+    TerrainType terrainAt(int r, int c) const;
+    // Cells of the given type in the rectangle [rowFrom, rowTo] x [colFrom, colTo],
+    // clipped to the map.
+    long long countInRect(TerrainType type, int rowFrom, int colFrom, int rowTo, int colTo) const;
+    size_t memoryBytes() const;
 };
 
 class BattleField {
 private:
     int n_rows, n_cols;
+    vector<Position> terrain[SPECIAL_ZONE + 1];
+    vector<TerrainElement*> elements;
+    UnitSpatialIndex unitIndex;
+    TerrainGrid grid;
 public:
     BattleField(int n_rows, int n_cols, vector<Position *> arrayForest,
                 vector<Position *> arrayRiver, vector<Position *> arrayFortification,
                 vector<Position *> arrayUrban, vector<Position *> arraySpecialZone);
     ~BattleField();
     string str() const;
+    void appendTo(string &out) const;
     int getRows() const;
     int getCols() const;
+    const vector<Position>& getTerrainPositions(TerrainType type) const;
+    TerrainType terrainAt(int r, int c) const;
+    TerrainType terrainAt(const Position &pos) const;
+    long long countTerrain(TerrainType type, int rowFrom, int colFrom, int rowTo, int colTo) const;
+    const TerrainGrid& getTerrainGrid() const;
+    // Snapshot of where the armies' units stand; rebuild after units change.
+    void indexUnits(Army *first, Army *second);
+    void unitsWithin(const Army *army, const Position &center, int radius, vector<Unit*> &out) const;
+    const vector<TerrainElement*>& getTerrainElements() const;
+    void applyTerrainEffects(Army *first, Army *second);
+};
+
+// Units taken from the enemy by confiscate(), counted per type.
+struct ConfiscationTally {
+    int vehicles[TANK + 1];
+    int infantry[REGULARINFANTRY + 1];
+    int total() const;
+    void add(const ConfiscationTally &other);
+};
+
+struct ArmySnapshot {
+    int LF, EXP;
+    bool defeated;
+    ConfiscationTally confiscated;
+    UnitList::Snapshot units;
 };
 
 class Army {
 protected:
+    // Uncapped running sums of the vehicle/infantry effective scores, kept up
+    // to date by UnitList. getLF()/getEXP() apply the 1000/500 caps.
     int LF, EXP;
     string name;
     UnitList *unitList;
     BattleField *battleField;
+    // Set when an attacker confiscated our units; read by the defending fight.
+    bool defeated;
+    ConfiscationTally confiscated;
 public:
-    Army(Unit **unitArray, int size, string name, BattleField *battleField);
+    Army(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool = nullptr);
     virtual ~Army();
+    Army(const Army &) = delete;
+    Army &operator=(const Army &) = delete;
+    void saveTo(ArmySnapshot &snapshot) const;
+    void restoreFrom(const ArmySnapshot &snapshot);
     virtual void fight(Army *enemy, bool defense = false) = 0;
     virtual string str() const = 0;
+    virtual void appendTo(string &out) const = 0;
+    virtual bool isLiberationArmy() const;
     int getLF() const;
     int getEXP() const;
     string getName() const;
     UnitList* getUnitList() const;
+    // What this army has confiscated from its enemy so far.
+    const ConfiscationTally &getConfiscated() const;
     void updateLF_EXP();
+    void applyScoreDelta(UnitKind kind, int delta);
+    void applyScoreDelta(int lfDelta, int expDelta);
+protected:
+    // Shared body of the subclasses' appendTo: label[name=..,LF=..,EXP=..,UnitList[..]]
+    void appendArmy(string &out, const char *label) const;
+    bool findCombination(UnitKind kind, int threshold, vector<Unit*> &combination) const;
+    void removeUnits(const vector<Unit*> &units);
+    void removeUnitsOfKind(UnitKind kind);
+    void confiscate(Army *enemy);
+    void scaleQuantities(int percent);
+    void scaleWeights(int percent);
 };
 
 class LiberationArmy : public Army {
+private:
+    void attack(Army *enemy);
+    void defend(Army *enemy);
 public:
-    LiberationArmy(Unit **unitArray, int size, string name, BattleField *battleField);
+    LiberationArmy(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool = nullptr);
     void fight(Army *enemy, bool defense = false);
     string str() const;
+    void appendTo(string &out) const;
+    bool isLiberationArmy() const;
 };
 
 class ARVN : public Army {
 public:
-    ARVN(Unit **unitArray, int size, string name, BattleField *battleField);
+    ARVN(Unit **unitArray, int size, string name, BattleField *battleField, UnitPool *pool = nullptr);
     void fight(Army *enemy, bool defense = false);
     string str() const;
+    void appendTo(string &out) const;
+};
+
+// Maps the UNIT_LIST spelling of every VehicleType/InfantryType to its kind
+// and enum value through a compile-time perfect hash.
+class UnitNameTable {
+public:
+    static bool lookup(const char *name, size_t len, UnitKind &kind, int &type);
+    static const char *name(UnitKind kind, int type);
 };
 
 class Configuration {
@@ -135,10 +569,27 @@ private:
     Unit** ARVNUnits;
     int ARVNUnitsCount;
     int eventCode;
+    // Positions are stored by value here; the array* vectors point into it.
+    vector<Position> terrainStore[SPECIAL_ZONE + 1];
+    vector<string> diagnostics;
+    UnitPool *pool;
+    // Empty configuration for loaders that fill the fields themselves.
+    explicit Configuration(UnitPool *pool);
+    void load(istream &in);
+    void parseLine(const char *begin, const char *end, int lineNo, vector<Unit*> &liber, vector<Unit*> &arvn);
+    Unit *makeUnit(UnitKind kind, int type, int quantity, int weight, const Position &pos);
+    // Final steps shared by every loader: point the array* vectors into
+    // terrainStore and move the parsed units into the owned arrays.
+    void linkTerrain();
+    void adoptUnits(const vector<Unit*> &liber, const vector<Unit*> &arvn);
+    friend class ScenarioBinary;
 public:
-    Configuration(const string& filepath);
+    Configuration(const string& filepath, UnitPool *pool = nullptr);
+    // Reads the same KEY=VALUE format from an already open stream.
+    Configuration(istream &in, UnitPool *pool = nullptr);
     ~Configuration();
     string str() const;
+    void appendTo(string &out) const;
     int getNumRows() const;
     int getNumCols() const;
     const vector<Position*>& getArrayForest() const;
@@ -151,19 +602,173 @@ public:
     Unit** getARVNUnits() const;
     int getARVNUnitsCount() const;
     int getEventCode() const;
+    // Problems met while reading the file, as "line L, column C: message".
+    const vector<string>& getDiagnostics() const;
+};
+
+#ifdef HCM_INSTRUMENT
+// Opt-in counters for one campaign, compiled in with -DHCM_INSTRUMENT (every
+// translation unit must agree on the flag). Code running on behalf of a
+// campaign reaches them through `current`, which is per thread, so campaigns
+// on different threads never share counters.
+class CampaignStats {
+public:
+    enum Stage { TERRAIN, LIBERATION_FIGHT, ARVN_FIGHT, REMOVE_WEAK_UNITS, STAGE_COUNT };
+    long long calls[STAGE_COUNT];
+    long long nanos[STAGE_COUNT];
+    long long allocations[STAGE_COUNT];
+    long long insertMerges, insertAppends;
+    long long unitAllocations;
+    // Incremental LF/EXP updates (Army::applyScoreDelta).
+    long long scoreDeltas;
+    static thread_local CampaignStats *current;
+    // Nanosecond clock used to time stages. Defined in campaign_stats.cpp,
+    // so an instrumented build that leaves that file out fails to link.
+    static long long clockNanos();
+    CampaignStats();
+    // Adds every counter of other to ours, e.g. to total a batch.
+    void add(const CampaignStats &other);
+    // CSV: stage,calls,ms,unit_allocations, then the other counters.
+    string report() const;
+};
+#endif
+
+// Everything run() can change. The configuration and terrain are never
+// modified after construction, so they are shared rather than copied.
+struct CampaignSnapshot {
+    ArmySnapshot liberationArmy, arvn;
+    bool terrainApplied;
+};
+
+// run() as a list of named steps over one CampaignState. Each step reads the
+// fields filled by the steps before it and fills its own, so steps can be
+// timed one at a time, dropped, reordered or swapped for experiments.
+// Parsing is not a step: each HCMCampaign constructor hands over a
+// Configuration built from its own source.
+enum CampaignEvent { LIBERATION_OFFENSIVE, ARVN_OFFENSIVE };
+
+struct Engagement {
+    Army *attacker, *defender;
+};
+
+struct CampaignState {
+    // The longest plan: ARVN attacks, then the Liberation Army counterattacks.
+    static const int MAX_ENGAGEMENTS = 2;
+    // inputs
+    UnitPool *pool;
+    Configuration *config;
+    int eventCode;
+    // buildBattleField / buildArmies
+    BattleField *battleField;
+    LiberationArmy *liberationArmy;
+    ARVN *arvn;
+    // applyTerrain
+    bool terrainApplied;
+    // dispatch
+    CampaignEvent event;
+    Engagement plan[MAX_ENGAGEMENTS];
+    int planned;
+    // battle / removeWeakUnits
+    int fought;
+    bool weakUnitsPending;
+    // result
+    string result;
+    // Nothing built yet; the caller keeps ownership of whatever the steps build.
+    CampaignState(Configuration *config, UnitPool *pool, int eventCode);
+};
+
+typedef void (*CampaignStepFunction)(CampaignState &state);
+
+struct CampaignStep {
+    const char *name;
+    CampaignStepFunction apply;
+};
+
+// The built-in steps.
+class CampaignSteps {
+public:
+    static void buildBattleField(CampaignState &state);
+    static void buildArmies(CampaignState &state);
+    static void applyTerrain(CampaignState &state);
+    // Event code < 75: the Liberation Army attacks. Otherwise ARVN attacks
+    // and the Liberation Army counterattacks. The battle steps only fight
+    // what was planned, so a custom dispatch that plans nothing is a
+    // ceasefire.
+    static void dispatch(CampaignState &state);
+    // Fights the next planned engagement, if any: attacker, then defender.
+    static void battle(CampaignState &state);
+    // Drops units with attackScore <= 5 from both armies after a battle.
+    static void removeWeakUnits(CampaignState &state);
+    static void result(CampaignState &state);
+};
+
+class CampaignPipeline {
+private:
+    vector<CampaignStep> steps;
+public:
+    // buildBattleField, buildArmies
+    static CampaignPipeline deployment();
+    // dispatch, then battle + removeWeakUnits once per possible engagement
+    static CampaignPipeline resolution();
+    // applyTerrain, the resolution steps, result: what run() does
+    static CampaignPipeline standard();
+    CampaignPipeline &add(const char *name, CampaignStepFunction apply);
+    CampaignPipeline &add(const CampaignPipeline &other);
+    // Removes every step with this name; returns how many were removed.
+    int remove(const string &name);
+    int size() const;
+    const CampaignStep &operator[](int idx) const;
+    void run(CampaignState &state) const;
 };
 
 class HCMCampaign {
 private:
+    // Every unit of the campaign lives here; declared first, freed last.
+    UnitPool *unitPool;
     Configuration *config;
     BattleField *battleField;
     LiberationArmy *liberationArmy;
     ARVN *arvn;
+    bool terrainApplied;
+#ifdef HCM_INSTRUMENT
+    CampaignStats stats;
+#endif
+    string lastResult;
+    void deploy();
+    void reportDiagnostics(const string &source) const;
+    CampaignState currentState(int eventCode) const;
+    void adoptState(const CampaignState &state);
 public:
+    // A campaign only touches its own objects, so separate instances can run
+    // on separate threads. Problems in the configuration text are written to
+    // cerr as "source: line L, column C: message".
     HCMCampaign(const string &config_file_path);
+    HCMCampaign(istream &config_text, const string &source = "config");
+    // Takes ownership of a configuration loaded some other way.
+    HCMCampaign(Configuration *config);
     ~HCMCampaign();
+    HCMCampaign(const HCMCampaign &) = delete;
+    HCMCampaign &operator=(const HCMCampaign &) = delete;
     void run();
+    // Runs the given steps with the configured event code instead of the
+    // standard pipeline.
+    void run(const CampaignPipeline &pipeline);
+    // run() split in two, so a campaign can be snapshotted after terrain and
+    // the battle replayed under several event codes.
+    void applyTerrain();
+    void resolve(int eventCode);
+    // Output of the last pipeline's result step; empty if it had none.
+    const string &getLastResult() const;
+    void saveTo(CampaignSnapshot &snapshot) const;
+    void restoreFrom(const CampaignSnapshot &snapshot);
     string printResult();
+    const LiberationArmy *getLiberationArmy() const;
+    const ARVN *getARVN() const;
+    // Everything the configuration loader reported; empty for a clean file.
+    const vector<string> &getDiagnostics() const;
+#ifdef HCM_INSTRUMENT
+    const CampaignStats &getStats() const;
+#endif
 };
 
 #endif
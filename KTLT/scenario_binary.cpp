@@ -0,0 +1,131 @@
+#include "scenario_binary.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ====================== ScenarioBinary ==========================
+static const char SCENARIO_MAGIC[4] = { 'H', 'C', 'M', 'B' };
+
+static void appendBytes(vector<char> &out, const void *data, size_t size) {
+    const char *p = static_cast<const char*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+static void appendUnits(vector<char> &out, Unit **units, int count, uint8_t army) {
+    for (int i = 0; i < count; ++i) {
+        const Unit *unit = units[i];
+        PackedUnit packed;
+        packed.kind = unit->getKind();
+        packed.type = unit->getKind() == VEHICLE_UNIT ? (uint8_t)static_cast<const Vehicle*>(unit)->getVehicleType()
+                                                      : (uint8_t)static_cast<const Infantry*>(unit)->getInfantryType();
+        packed.army = army;
+        packed.reserved = 0;
+        packed.quantity = unit->getQuantity();
+        packed.weight = unit->getWeight();
+        packed.r = unit->getCurrentPosition().getRow();
+        packed.c = unit->getCurrentPosition().getCol();
+        appendBytes(out, &packed, sizeof(packed));
+    }
+}
+
+bool ScenarioBinary::write(const Configuration &config, const string &path) {
+    const vector<Position*> *terrain[SPECIAL_ZONE] = {
+        &config.getArrayForest(), &config.getArrayRiver(), &config.getArrayFortification(),
+        &config.getArrayUrban(), &config.getArraySpecialZone()
+    };
+    ScenarioHeader header;
+    memcpy(header.magic, SCENARIO_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.numRows = config.getNumRows();
+    header.numCols = config.getNumCols();
+    header.eventCode = config.getEventCode();
+    for (int t = 0; t < SPECIAL_ZONE; ++t) header.terrainCount[t] = terrain[t]->size();
+    header.unitCount = config.getLiberationUnitsCount() + config.getARVNUnitsCount();
+
+    vector<char> out;
+    appendBytes(out, &header, sizeof(header));
+    for (int t = 0; t < SPECIAL_ZONE; ++t)
+        for (size_t i = 0; i < terrain[t]->size(); ++i) {
+            int32_t rc[2] = { (*terrain[t])[i]->getRow(), (*terrain[t])[i]->getCol() };
+            appendBytes(out, rc, sizeof(rc));
+        }
+    appendUnits(out, config.getLiberationUnits(), config.getLiberationUnitsCount(), 0);
+    appendUnits(out, config.getARVNUnits(), config.getARVNUnitsCount(), 1);
+
+    ofstream fout(path.c_str(), ios::binary);
+    fout.write(out.data(), out.size());
+    return (bool)fout;
+}
+
+bool ScenarioBinary::convert(const string &textPath, const string &binaryPath) {
+    ifstream probe(textPath.c_str());
+    if (!probe) return false;
+    Configuration config(textPath);
+    return write(config, binaryPath);
+}
+
+Configuration *ScenarioBinary::load(const string &path, UnitPool *pool) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ScenarioHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return nullptr;
+    const char *base = static_cast<const char*>(mapped);
+
+    ScenarioHeader header;
+    memcpy(&header, base, sizeof(header));
+    size_t terrainTotal = 0;
+    for (int t = 0; t < SPECIAL_ZONE; ++t) terrainTotal += header.terrainCount[t];
+    size_t expected = sizeof(header) + terrainTotal * 2 * sizeof(int32_t) + (size_t)header.unitCount * sizeof(PackedUnit);
+    bool valid = memcmp(header.magic, SCENARIO_MAGIC, sizeof(header.magic)) == 0 && header.version == VERSION
+              && expected == size;
+    for (uint32_t i = 0; valid && i < header.unitCount; ++i) {
+        PackedUnit packed;
+        memcpy(&packed, base + size - (header.unitCount - i) * sizeof(PackedUnit), sizeof(packed));
+        valid = packed.army <= 1
+             && ((packed.kind == VEHICLE_UNIT && packed.type <= TANK)
+                 || (packed.kind == INFANTRY_UNIT && packed.type <= REGULARINFANTRY));
+    }
+    if (!valid) {
+        munmap(mapped, size);
+        return nullptr;
+    }
+
+    Configuration *config = new Configuration(pool);
+    config->num_rows = header.numRows;
+    config->num_cols = header.numCols;
+    config->eventCode = header.eventCode;
+    const char *p = base + sizeof(header);
+    for (int t = 0; t < SPECIAL_ZONE; ++t) {
+        vector<Position> &store = config->terrainStore[FOREST + t];
+        store.reserve(header.terrainCount[t]);
+        for (uint32_t i = 0; i < header.terrainCount[t]; ++i, p += 2 * sizeof(int32_t)) {
+            int32_t rc[2];
+            memcpy(rc, p, sizeof(rc));
+            store.push_back(Position(rc[0], rc[1]));
+        }
+    }
+    vector<Unit*> liber, arvn;
+    for (uint32_t i = 0; i < header.unitCount; ++i, p += sizeof(PackedUnit)) {
+        PackedUnit packed;
+        memcpy(&packed, p, sizeof(packed));
+        Unit *unit = config->makeUnit((UnitKind)packed.kind, packed.type, packed.quantity, packed.weight,
+                                      Position(packed.r, packed.c));
+        (packed.army == 0 ? liber : arvn).push_back(unit);
+    }
+    munmap(mapped, size);
+    config->linkTerrain();
+    config->adoptUnits(liber, arvn);
+    return config;
+}
+
+bool ScenarioBinary::isBinaryPath(const string &path) {
+    return path.size() >= 5 && path.compare(path.size() - 5, 5, ".hcmb") == 0;
+}
@@ -0,0 +1,46 @@
+#ifndef _SCENARIO_BINARY_H_
+#define _SCENARIO_BINARY_H_
+
+// Compiled scenario format (.hcmb), read back with mmap. Kept out of
+// hcmcampaign.{h,cpp} because it needs POSIX headers.
+//
+// Layout, host byte order:
+//   header      magic "HCMB", version, num_rows, num_cols, eventCode,
+//               terrain count for FOREST..SPECIAL_ZONE (5), unit count
+//   terrain     (r, c) pairs, FOREST first, in configuration order
+//   units       PackedUnit records, liberation units first, each army in
+//               configuration order
+// Values are stored after the text loader's normalisation (EVENT_CODE in
+// [0,99]), so loading does no parsing at all.
+
+#include "hcmcampaign.h"
+#include <cstdint>
+
+struct ScenarioHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t numRows, numCols, eventCode;
+    uint32_t terrainCount[SPECIAL_ZONE];
+    uint32_t unitCount;
+};
+
+struct PackedUnit {
+    uint8_t kind;   // UnitKind
+    uint8_t type;   // VehicleType or InfantryType
+    uint8_t army;   // 0 = liberation, 1 = ARVN
+    uint8_t reserved;
+    int32_t quantity, weight, r, c;
+};
+
+class ScenarioBinary {
+public:
+    static const uint32_t VERSION = 1;
+    static bool write(const Configuration &config, const string &path);
+    // Converts a text config; returns false if either file cannot be used.
+    static bool convert(const string &textPath, const string &binaryPath);
+    // nullptr if the file is missing, truncated or not this format.
+    static Configuration *load(const string &path, UnitPool *pool = nullptr);
+    static bool isBinaryPath(const string &path);
+};
+
+#endif
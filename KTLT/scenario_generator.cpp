@@ -0,0 +1,55 @@
+#include "scenario_generator.h"
+
+// ====================== ScenarioRandom ==========================
+int ScenarioRandom::next(int lo, int hi) {
+    seed = seed * 1103515245u + 12345u;
+    return lo + (int)((seed >> 8) % (unsigned int)(hi - lo + 1));
+}
+
+const char *ScenarioRandom::unitName() {
+    int k = next(0, TANK + REGULARINFANTRY + 1);
+    return k <= TANK ? UnitNameTable::name(VEHICLE_UNIT, k) : UnitNameTable::name(INFANTRY_UNIT, k - TANK - 1);
+}
+
+const char *ScenarioRandom::unitName(UnitKind kind) {
+    return UnitNameTable::name(kind, kind == VEHICLE_UNIT ? next(0, TANK) : next(0, REGULARINFANTRY));
+}
+
+// ====================== ScenarioGenerator ==========================
+// Every draw goes through a local first: the operands of one << chain are
+// unsequenced before C++17, so the same seed could otherwise give different
+// text under different compilers.
+string ScenarioGenerator::generate(const ScenarioSpec &spec, ScenarioRandom &random) {
+    static const char *TERRAIN_KEYS[] = { "ARRAY_FOREST", "ARRAY_RIVER", "ARRAY_FORTIFICATION", "ARRAY_URBAN", "ARRAY_SPECIAL_ZONE" };
+    ostringstream out;
+    out << "NUM_ROWS=" << spec.rows << "\nNUM_COLS=" << spec.cols << "\n";
+    long long cells = (long long)(spec.terrainDensity * spec.rows * spec.cols);
+    for (int t = 0; t < 5; ++t) {
+        out << TERRAIN_KEYS[t] << "=[";
+        for (long long i = t; i < cells; i += 5) {
+            if (i >= 5) out << ",";
+            int r = random.next(0, spec.rows - 1);
+            int c = random.next(0, spec.cols - 1);
+            out << "(" << r << "," << c << ")";
+        }
+        out << "]\n";
+    }
+    out << "UNIT_LIST=[";
+    for (int i = 0; i < spec.units; ++i) {
+        if (i > 0) out << ",";
+        bool vehicle = random.next(0, 99) < spec.vehiclePercent;
+        const char *name = random.unitName(vehicle ? VEHICLE_UNIT : INFANTRY_UNIT);
+        int quantity = random.next(1, 20), weight = random.next(1, 20);
+        int r = random.next(0, spec.rows - 1), c = random.next(0, spec.cols - 1);
+        int army = random.next(0, 1);
+        out << name << "(" << quantity << "," << weight << ",(" << r << "," << c << ")," << army << ")";
+    }
+    out << "]\n";
+    return out.str();
+}
+
+string ScenarioGenerator::label(const ScenarioSpec &spec) {
+    ostringstream oss;
+    oss << spec.rows << "x" << spec.cols << "_t" << spec.terrainDensity << "_u" << spec.units << "_v" << spec.vehiclePercent;
+    return oss.str();
+}
@@ -0,0 +1,38 @@
+#ifndef _SCENARIO_GENERATOR_H_
+#define _SCENARIO_GENERATOR_H_
+
+// Synthetic input shared by bench and check: a seeded generator and a text
+// scenario writer. Unit names come from UnitNameTable, so every type is
+// spelled exactly as the loader reads it.
+
+#include "hcmcampaign.h"
+
+class ScenarioRandom {
+private:
+    unsigned int seed;
+public:
+    explicit ScenarioRandom(unsigned int seed) : seed(seed) {}
+    // Linear congruential step; returns a value in [lo, hi].
+    int next(int lo, int hi);
+    // Name of a random unit type of either kind, or of the given kind.
+    const char *unitName();
+    const char *unitName(UnitKind kind);
+};
+
+struct ScenarioSpec {
+    int rows, cols;
+    double terrainDensity;  // fraction of cells holding a terrain element
+    int units;
+    int vehiclePercent;     // share of units that are vehicles
+};
+
+class ScenarioGenerator {
+public:
+    // Terrain cells are split evenly over the five terrain keys; units get
+    // quantity and weight in [1, 20] and go to either army with equal odds.
+    // No EVENT_CODE line: the caller appends one.
+    static string generate(const ScenarioSpec &spec, ScenarioRandom &random);
+    static string label(const ScenarioSpec &spec);
+};
+
+#endif /* _SCENARIO_GENERATOR_H_ */
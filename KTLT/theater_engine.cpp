@@ -0,0 +1,91 @@
+#include "theater_engine.h"
+#include <memory>
+#include <thread>
+
+// ====================== TheaterEngine ==========================
+static void capture(const HCMCampaign &campaign, TheaterOutcome &outcome, int when) {
+    const Army *liberation = campaign.getLiberationArmy();
+    const Army *arvn = campaign.getARVN();
+    outcome.liberationLF[when] = liberation->getLF();
+    outcome.liberationEXP[when] = liberation->getEXP();
+    outcome.liberationUnitCount[when] = liberation->getUnitList()->getTotalCount();
+    outcome.arvnLF[when] = arvn->getLF();
+    outcome.arvnEXP[when] = arvn->getEXP();
+    outcome.arvnUnitCount[when] = arvn->getUnitList()->getTotalCount();
+}
+
+static void resolveTheater(const Scenario &theater, TheaterOutcome &outcome) {
+    unique_ptr<HCMCampaign> campaign(BatchRunner::open(theater));
+    if (!campaign) {
+        outcome.failed = true;
+        outcome.result = "error: cannot load " + theater.path;
+        return;
+    }
+    outcome.clean = campaign->getDiagnostics().empty();
+    campaign->applyTerrain();
+    capture(*campaign, outcome, 0);
+    campaign->run();
+    capture(*campaign, outcome, 1);
+    outcome.confiscated = campaign->getLiberationArmy()->getConfiscated();
+    outcome.result = campaign->printResult();
+}
+
+// Every theater must report exactly once or the aggregator never finishes,
+// so a worker turns any exception into a failed outcome.
+static TheaterOutcome resolveOrFail(const Scenario &theater, size_t index) {
+    TheaterOutcome outcome = TheaterOutcome();
+    outcome.theater = index;
+    try {
+        resolveTheater(theater, outcome);
+    } catch (const exception &e) {
+        outcome = TheaterOutcome();
+        outcome.theater = index;
+        outcome.failed = true;
+        outcome.result = string("error: ") + e.what();
+    } catch (...) {
+        outcome = TheaterOutcome();
+        outcome.theater = index;
+        outcome.failed = true;
+        outcome.result = "error: unknown exception";
+    }
+    return outcome;
+}
+
+bool TheaterEngine::run(const vector<Scenario> &theaters, WorkStealingPool &pool, TheaterReport &report) {
+    MpscQueue<TheaterOutcome> queue;
+    thread workers([&theaters, &pool, &queue]() {
+        pool.run(theaters.size(), [&theaters, &queue](size_t i) { queue.push(resolveOrFail(theaters[i], i)); });
+    });
+
+    report.outcomes.assign(theaters.size(), TheaterOutcome());
+    report.liberationLFDelta = report.liberationEXPDelta = 0;
+    report.arvnLFDelta = report.arvnEXPDelta = 0;
+    report.liberationUnitCountDelta = report.arvnUnitCountDelta = 0;
+    report.confiscated = ConfiscationTally();
+    report.failed = 0;
+    size_t received = 0;
+    bool clean = true;
+    TheaterOutcome outcome;
+    while (received < theaters.size()) {
+        if (!queue.pop(outcome)) {
+            this_thread::yield();
+            continue;
+        }
+        report.outcomes[outcome.theater] = outcome;
+        received++;
+        clean = clean && outcome.clean && !outcome.failed;
+        if (outcome.failed) {
+            report.failed++;
+            continue;
+        }
+        report.liberationLFDelta += outcome.liberationLF[1] - outcome.liberationLF[0];
+        report.liberationEXPDelta += outcome.liberationEXP[1] - outcome.liberationEXP[0];
+        report.arvnLFDelta += outcome.arvnLF[1] - outcome.arvnLF[0];
+        report.arvnEXPDelta += outcome.arvnEXP[1] - outcome.arvnEXP[0];
+        report.liberationUnitCountDelta += outcome.liberationUnitCount[1] - outcome.liberationUnitCount[0];
+        report.arvnUnitCountDelta += outcome.arvnUnitCount[1] - outcome.arvnUnitCount[0];
+        report.confiscated.add(outcome.confiscated);
+    }
+    workers.join();
+    return clean;
+}
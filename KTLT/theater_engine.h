@@ -0,0 +1,84 @@
+#ifndef _THEATER_ENGINE_H_
+#define _THEATER_ENGINE_H_
+
+// Resolves several independent theaters at once. Each theater is a whole
+// HCMCampaign (battlefield plus both armies), so no Army or Unit is ever
+// reachable from two threads; workers only share the outcome queue.
+
+#include "batch_runner.h"
+#include <atomic>
+
+// Unbounded multi-producer / single-consumer queue (Vyukov's intrusive
+// design). push never blocks or locks; pop must only be called from one
+// thread and returns false when nothing is ready yet.
+template <class T> class MpscQueue {
+private:
+    struct Node {
+        atomic<Node*> next;
+        T value;
+        Node() : next(nullptr) {}
+    };
+    atomic<Node*> head;  // last pushed node, swapped by producers
+    Node *tail;          // consumed stub; tail->next is the oldest entry
+public:
+    MpscQueue() : head(new Node()), tail(head.load()) {}
+    ~MpscQueue() {
+        while (tail) {
+            Node *next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+    }
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+    void push(const T &value) {
+        Node *node = new Node();
+        node->value = value;
+        Node *prev = head.exchange(node, memory_order_acq_rel);
+        prev->next.store(node, memory_order_release);
+    }
+    bool pop(T &value) {
+        Node *next = tail->next.load(memory_order_acquire);
+        if (!next) return false;
+        value = next->value;
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
+
+// Before/after picture of one theater, taken after terrain ([0]) and after
+// the battle ([1]), as pushed by the worker that resolved it. A theater that
+// failed to load or threw has failed set, its error in result and nothing
+// else filled in.
+struct TheaterOutcome {
+    size_t theater;
+    int liberationLF[2], liberationEXP[2], liberationUnitCount[2];
+    int arvnLF[2], arvnEXP[2], arvnUnitCount[2];
+    // Units the Liberation Army took from ARVN in this theater.
+    ConfiscationTally confiscated;
+    bool clean;  // loaded, with no configuration diagnostics
+    bool failed;
+    string result;
+};
+
+// Sums over the theaters that did not fail.
+struct TheaterReport {
+    vector<TheaterOutcome> outcomes;  // indexed by theater
+    long long liberationLFDelta, liberationEXPDelta;
+    long long arvnLFDelta, arvnEXPDelta;
+    // Net change in each army's unit count: confiscation, merging and losses.
+    long long liberationUnitCountDelta, arvnUnitCountDelta;
+    ConfiscationTally confiscated;
+    size_t failed;
+};
+
+class TheaterEngine {
+public:
+    // Workers resolve theaters and push outcomes; the calling thread is the
+    // single aggregator and drains the queue until every theater reported.
+    // False if any theater failed to load or had configuration diagnostics.
+    static bool run(const vector<Scenario> &theaters, WorkStealingPool &pool, TheaterReport &report);
+};
+
+#endif